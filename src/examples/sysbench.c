@@ -0,0 +1,98 @@
+/* sysbench.c
+
+   Measures the round-trip cost of a system call that does
+   almost nothing, a zero-byte write to the console, made with
+   "int $0x30" and, if the CPU supports it, with sysenter.  The
+   difference is the cost of the generic interrupt path.  The
+   C library picks one of the two for all system calls, so this
+   program makes the calls itself. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <syscall.h>
+#include <syscall-nr.h>
+
+/* Number of system calls to time. */
+#define CALLS 10000
+
+/* CPUID leaf 1 EDX flag for SYSENTER and SYSEXIT. */
+#define CPUID_SEP 0x00000800
+
+/* Returns the CPU's time-stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Returns true if the CPU supports sysenter. */
+static bool
+have_sysenter (void)
+{
+  uint32_t eax = 1, ebx, ecx = 0, edx;
+  asm ("cpuid" : "+a" (eax), "=b" (ebx), "+c" (ecx), "=d" (edx));
+  return (edx & CPUID_SEP) != 0;
+}
+
+/* Writes zero bytes to the console with "int $0x30". */
+static void
+write_int (void)
+{
+  int retval;
+  asm volatile
+    ("pushl $0; pushl $0; pushl %[fd]; pushl %[number]; "
+     "int $0x30; addl $16, %%esp"
+     : "=a" (retval)
+     : [number] "i" (SYS_WRITE), [fd] "i" (STDOUT_FILENO)
+     : "memory");
+}
+
+/* Writes zero bytes to the console with sysenter, which returns
+   to the address in EDX with the stack pointer in ECX. */
+static void
+write_sysenter (void)
+{
+  int retval;
+  asm volatile
+    ("pushl $0; pushl $0; pushl %[fd]; pushl %[number]; "
+     "movl %%esp, %%ecx; movl $1f, %%edx; sysenter; "
+     "1: addl $16, %%esp"
+     : "=a" (retval)
+     : [number] "i" (SYS_WRITE), [fd] "i" (STDOUT_FILENO)
+     : "ecx", "edx", "memory");
+}
+
+/* Calls CALL CALLS times and returns the average number of
+   cycles each call took. */
+static uint64_t
+time_calls (void (*call) (void))
+{
+  uint64_t start = rdtsc ();
+  int i;
+
+  for (i = 0; i < CALLS; i++)
+    call ();
+  return (rdtsc () - start) / CALLS;
+}
+
+int
+main (void)
+{
+  uint64_t slow, fast;
+
+  slow = time_calls (write_int);
+  printf ("int $0x30: %llu cycles per call\n", slow);
+  if (!have_sysenter ())
+    {
+      printf ("sysenter: not supported by this CPU\n");
+      return EXIT_SUCCESS;
+    }
+
+  fast = time_calls (write_sysenter);
+  printf ("sysenter: %llu cycles per call\n", fast);
+  if (fast > 0)
+    printf ("speedup: %llu.%02llux\n", slow / fast, slow * 100 / fast % 100);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,82 @@
+/* tlbbench.c
+
+   Compares a loop that touches a different page on nearly every
+   access, run over a region mapped with ordinary 4 kB pages and
+   over one mapped with 4 MB pages.  The first needs a TLB entry
+   per page; the second needs one for the whole region.
+
+   The large page needs 4 MB of physically contiguous free user
+   memory, so run with plenty of it, e.g. "pintos -m 32".  The
+   kernel's "Paging:" statistics at shutdown say whether the
+   large page was mapped. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <syscall.h>
+
+/* Size of each region. */
+#define REGION_SIZE (4 * 1024 * 1024)
+
+/* Where to map the regions.  LARGE_BASE is 4 MB-aligned. */
+#define SMALL_BASE ((char *) 0x10000000)
+#define LARGE_BASE ((char *) 0x10400000)
+
+/* Distance between accesses: a page and a cache line, so that
+   every access is to a new page and a new line. */
+#define STRIDE (4096 + 64)
+
+/* Number of times to walk each region. */
+#define ROUNDS 64
+
+/* Returns the CPU's time-stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Walks the region at BASE ROUNDS times and returns the number
+   of cycles it took. */
+static uint64_t
+walk (volatile char *base)
+{
+  uint64_t start = rdtsc ();
+  int round;
+
+  for (round = 0; round < ROUNDS; round++)
+    {
+      size_t ofs;
+      for (ofs = 0; ofs < REGION_SIZE; ofs += STRIDE)
+        base[ofs]++;
+    }
+  return rdtsc () - start;
+}
+
+int
+main (void)
+{
+  uint64_t small, large;
+
+  if (mmap_anon (SMALL_BASE, REGION_SIZE, 0) == MAP_FAILED
+      || mmap_anon (LARGE_BASE, REGION_SIZE, MAP_LARGE) == MAP_FAILED)
+    {
+      printf ("tlbbench: mmap_anon failed\n");
+      return EXIT_FAILURE;
+    }
+
+  /* Fault in every page first, so that only TLB misses are
+     timed. */
+  walk (SMALL_BASE);
+  walk (LARGE_BASE);
+
+  small = walk (SMALL_BASE);
+  large = walk (LARGE_BASE);
+  printf ("4 kB pages: %llu cycles\n", small);
+  printf ("4 MB pages: %llu cycles\n", large);
+  if (large > 0)
+    printf ("speedup: %llu.%02llux\n",
+            small / large, small * 100 / large % 100);
+  return EXIT_SUCCESS;
+}
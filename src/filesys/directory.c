@@ -34,7 +34,7 @@ dir_create (block_sector_t sector, size_t entry_cnt)
 struct dir *
 dir_open (struct inode *inode) 
 {
-  struct dir *dir = calloc (1, sizeof *dir);
+  struct dir *dir = calloc_tagged (1, sizeof *dir, MEM_FILE);
   if (inode != NULL && dir != NULL)
     {
       dir->inode = inode;
@@ -36,6 +36,7 @@ struct inode
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    unsigned version;                   /* Changes when data is written. */
     struct inode_disk data;             /* Inode content. */
   };
 
@@ -57,6 +58,12 @@ byte_to_sector (const struct inode *inode, off_t pos)
    returns the same `struct inode'. */
 static struct list open_inodes;
 
+/* Next inode version number.  Every in-memory inode starts out
+   with a fresh version, so a version seen once is never seen
+   again for different contents, even after the inode is closed
+   and reopened. */
+static unsigned next_version;
+
 /* Initializes the inode module. */
 void
 inode_init (void) 
@@ -81,7 +88,7 @@ inode_create (block_sector_t sector, off_t length)
      one sector in size, and you should fix that. */
   ASSERT (sizeof *disk_inode == BLOCK_SECTOR_SIZE);
 
-  disk_inode = calloc (1, sizeof *disk_inode);
+  disk_inode = calloc_tagged (1, sizeof *disk_inode, MEM_INODE);
   if (disk_inode != NULL)
     {
       size_t sectors = bytes_to_sectors (length);
@@ -127,7 +134,7 @@ inode_open (block_sector_t sector)
     }
 
   /* Allocate memory. */
-  inode = malloc (sizeof *inode);
+  inode = malloc_tagged (sizeof *inode, MEM_INODE);
   if (inode == NULL)
     return NULL;
 
@@ -137,6 +144,7 @@ inode_open (block_sector_t sector)
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
+  inode->version = next_version++;
   block_read (fs_device, inode->sector, &inode->data);
   return inode;
 }
@@ -157,6 +165,15 @@ inode_get_inumber (const struct inode *inode)
   return inode->sector;
 }
 
+/* Returns INODE's version number, which changes whenever INODE
+   is written, so that anything derived from its contents can
+   tell whether it is still current. */
+unsigned
+inode_get_version (const struct inode *inode)
+{
+  return inode->version;
+}
+
 /* Closes INODE and writes it to disk.
    If this was the last reference to INODE, frees its memory.
    If INODE was also a removed inode, frees its blocks. */
@@ -231,7 +248,7 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
              into caller's buffer. */
           if (bounce == NULL) 
             {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
+              bounce = malloc_tagged (BLOCK_SECTOR_SIZE, MEM_FILE);
               if (bounce == NULL)
                 break;
             }
@@ -264,6 +281,7 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 
   if (inode->deny_write_cnt)
     return 0;
+  inode->version = next_version++;
 
   while (size > 0) 
     {
@@ -291,7 +309,7 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
           /* We need a bounce buffer. */
           if (bounce == NULL) 
             {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
+              bounce = malloc_tagged (BLOCK_SECTOR_SIZE, MEM_FILE);
               if (bounce == NULL)
                 break;
             }
@@ -27,6 +27,7 @@ typedef unsigned long elem_type;
 struct bitmap
   {
     size_t bit_cnt;     /* Number of bits. */
+    size_t next_fit;    /* Where bitmap_scan_and_flip_next() starts. */
     elem_type *bits;    /* Elements that represent bits. */
   };
 
@@ -69,6 +70,44 @@ last_mask (const struct bitmap *b)
   return last_bits ? ((elem_type) 1 << last_bits) - 1 : (elem_type) -1;
 }
 
+/* Returns an elem_type with the CNT bits starting at bit OFS
+   turned on.  OFS + CNT must not exceed ELEM_BITS. */
+static inline elem_type
+range_mask (size_t ofs, size_t cnt) 
+{
+  elem_type bits = cnt < ELEM_BITS ? ((elem_type) 1 << cnt) - 1 : (elem_type) -1;
+  return bits << ofs;
+}
+
+/* Returns an elem_type that, XORed with an element, turns bits
+   equal to VALUE on and the others off. */
+static inline elem_type
+value_flip (bool value) 
+{
+  return value ? 0 : (elem_type) -1;
+}
+
+/* Returns the index of the lowest bit that is on in W, which
+   must be nonzero.  See the description of the BSF instruction
+   in [IA32-v2a]. */
+static inline size_t
+lowest_bit (elem_type w) 
+{
+  elem_type idx;
+  asm ("bsfl %1, %0" : "=r" (idx) : "rm" (w) : "cc");
+  return idx;
+}
+
+/* Returns the number of bits that are on in W. */
+static inline size_t
+popcount (elem_type w) 
+{
+  w = w - ((w >> 1) & 0x55555555);
+  w = (w & 0x33333333) + ((w >> 2) & 0x33333333);
+  w = (w + (w >> 4)) & 0x0f0f0f0f;
+  return (w * 0x01010101) >> 24;
+}
+
 /* Creation and destruction. */
 
 /* Creates and returns a pointer to a newly allocated bitmap with room for
@@ -82,6 +121,7 @@ bitmap_create (size_t bit_cnt)
   if (b != NULL)
     {
       b->bit_cnt = bit_cnt;
+      b->next_fit = 0;
       b->bits = malloc (byte_cnt (bit_cnt));
       if (b->bits != NULL || bit_cnt == 0)
         {
@@ -104,6 +144,7 @@ bitmap_create_in_buf (size_t bit_cnt, void *block, size_t block_size UNUSED)
   ASSERT (block_size >= bitmap_buf_size (bit_cnt));
 
   b->bit_cnt = bit_cnt;
+  b->next_fit = 0;
   b->bits = (elem_type *) (b + 1);
   bitmap_set_all (b, false);
   return b;
@@ -213,18 +254,33 @@ bitmap_set_all (struct bitmap *b, bool value)
   bitmap_set_multiple (b, 0, bitmap_size (b), value);
 }
 
-/* Sets the CNT bits starting at START in B to VALUE. */
+/* Sets the CNT bits starting at START in B to VALUE.
+   Each element is updated atomically, but the group as a whole
+   is not. */
 void
 bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
+  size_t end = start + cnt;
   size_t i;
   
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    bitmap_set (b, start + i, value);
+  for (i = start; i < end; ) 
+    {
+      size_t ofs = i % ELEM_BITS;
+      size_t n = end - i < ELEM_BITS - ofs ? end - i : ELEM_BITS - ofs;
+      elem_type mask = range_mask (ofs, n);
+      elem_type *e = &b->bits[elem_idx (i)];
+
+      /* See bitmap_mark() and bitmap_reset(). */
+      if (value)
+        asm ("orl %1, %0" : "=m" (*e) : "r" (mask) : "cc");
+      else
+        asm ("andl %1, %0" : "=m" (*e) : "r" (~mask) : "cc");
+      i += n;
+    }
 }
 
 /* Returns the number of bits in B between START and START + CNT,
@@ -232,17 +288,22 @@ bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value)
 size_t
 bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i, value_cnt;
+  size_t end = start + cnt;
+  size_t i, true_cnt;
 
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  value_cnt = 0;
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      value_cnt++;
-  return value_cnt;
+  true_cnt = 0;
+  for (i = start; i < end; ) 
+    {
+      size_t ofs = i % ELEM_BITS;
+      size_t n = end - i < ELEM_BITS - ofs ? end - i : ELEM_BITS - ofs;
+      true_cnt += popcount (b->bits[elem_idx (i)] & range_mask (ofs, n));
+      i += n;
+    }
+  return value ? true_cnt : cnt - true_cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -250,15 +311,22 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
+  size_t end = start + cnt;
+  elem_type flip = value_flip (value);
   size_t i;
   
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      return true;
+  for (i = start; i < end; ) 
+    {
+      size_t ofs = i % ELEM_BITS;
+      size_t n = end - i < ELEM_BITS - ofs ? end - i : ELEM_BITS - ofs;
+      if (((b->bits[elem_idx (i)] ^ flip) & range_mask (ofs, n)) != 0)
+        return true;
+      i += n;
+    }
   return false;
 }
 
@@ -288,6 +356,68 @@ bitmap_all (const struct bitmap *b, size_t start, size_t cnt)
 
 /* Finding set or unset bits. */
 
+/* Returns the index of the first bit in B at or after START and
+   before END that is set to VALUE, or END if there is none.
+   Whole elements that contain no such bit are skipped without
+   examining their bits individually. */
+static size_t
+find_next (const struct bitmap *b, size_t start, size_t end, bool value) 
+{
+  elem_type flip = value_flip (value);
+  size_t idx;
+  elem_type w;
+
+  if (start >= end)
+    return end;
+
+  idx = elem_idx (start);
+  w = (b->bits[idx] ^ flip) & ~range_mask (0, start % ELEM_BITS);
+  while (w == 0) 
+    {
+      if (++idx * ELEM_BITS >= end)
+        return end;
+      w = b->bits[idx] ^ flip;
+    }
+
+  start = idx * ELEM_BITS + lowest_bit (w);
+  return start < end ? start : end;
+}
+
+/* Finds and returns the starting index of the first group of CNT
+   consecutive bits in B at or after START and before END that
+   are all set to VALUE.
+   If there is no such group, returns BITMAP_ERROR.
+
+   Each iteration finds the next bit set to VALUE, then the
+   first bit within CNT of it that is not.  If there is none,
+   we have a group; otherwise no group can start before that
+   bit, so we resume from just past it.  Thus no bit is examined
+   more than once. */
+static size_t
+scan_range (const struct bitmap *b, size_t start, size_t end, size_t cnt,
+            bool value) 
+{
+  ASSERT (start <= end);
+
+  if (cnt == 0)
+    return start;
+
+  while (cnt <= end - start) 
+    {
+      size_t conflict;
+
+      start = find_next (b, start, end - cnt + 1, value);
+      if (start > end - cnt)
+        break;
+
+      conflict = find_next (b, start, start + cnt, !value);
+      if (conflict == start + cnt)
+        return start;
+      start = conflict + 1;
+    }
+  return BITMAP_ERROR;
+}
+
 /* Finds and returns the starting index of the first group of CNT
    consecutive bits in B at or after START that are all set to
    VALUE.
@@ -298,15 +428,7 @@ bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
 
-  if (cnt <= b->bit_cnt) 
-    {
-      size_t last = b->bit_cnt - cnt;
-      size_t i;
-      for (i = start; i <= last; i++)
-        if (!bitmap_contains (b, i, cnt, !value))
-          return i; 
-    }
-  return BITMAP_ERROR;
+  return scan_range (b, start, b->bit_cnt, cnt, value);
 }
 
 /* Finds the first group of CNT consecutive bits in B at or after
@@ -324,7 +446,38 @@ bitmap_scan_and_flip (struct bitmap *b, size_t start, size_t cnt, bool value)
     bitmap_set_multiple (b, idx, cnt, !value);
   return idx;
 }
-
+
+/* Like bitmap_scan_and_flip(), but next-fit: the search starts
+   just past the group found by the previous call and wraps
+   around to the beginning of B, so that a series of
+   allocations does not rescan the bits that earlier ones
+   already filled.
+   Bits are set atomically, but testing bits is not atomic with
+   setting them. */
+size_t
+bitmap_scan_and_flip_next (struct bitmap *b, size_t cnt, bool value)
+{
+  size_t hint, idx;
+
+  ASSERT (b != NULL);
+
+  hint = b->next_fit <= b->bit_cnt ? b->next_fit : 0;
+  idx = scan_range (b, hint, b->bit_cnt, cnt, value);
+  if (idx == BITMAP_ERROR && hint > 0) 
+    {
+      /* Wrap around.  A group may straddle HINT. */
+      size_t end = hint + cnt - 1 < b->bit_cnt ? hint + cnt - 1 : b->bit_cnt;
+      idx = scan_range (b, 0, end, cnt, value);
+    }
+
+  if (idx != BITMAP_ERROR) 
+    {
+      bitmap_set_multiple (b, idx, cnt, !value);
+      b->next_fit = idx + cnt;
+    }
+  return idx;
+}
+
 /* File input and output. */
 
 #ifdef FILESYS
@@ -0,0 +1,219 @@
+#include "lz.h"
+#include <debug.h>
+#include <stdbool.h>
+#include <string.h>
+
+/* Compressed format.
+
+   The output is a series of sequences.  Each sequence begins
+   with a token byte whose upper 4 bits give a number of literal
+   bytes and whose lower 4 bits give the length of a match, minus
+   MIN_MATCH.  The literal bytes follow the token.  Then, unless
+   the sequence is the last one, comes the match: a 2-byte
+   little-endian offset back into the output already produced,
+   from which the match is copied.  A length of 15 in either
+   half of the token means that more of the length follows, in
+   bytes that are added to it, up to and including the first byte
+   that is not 255: first the literal length, just after the
+   token, and then the match length, just after the offset.
+
+   The last sequence holds only literals, possibly none, and ends
+   where the input ends.  This is the same layout as LZ4's block
+   format. */
+
+/* Shortest match worth encoding. */
+#define MIN_MATCH 4
+
+/* Largest length that fits in half a token. */
+#define RUN_MASK 15
+
+/* Farthest back a match can be. */
+#define MAX_OFFSET 65535
+
+/* Returns the 4 bytes at P as an integer. */
+static inline uint32_t
+read32 (const uint8_t *p)
+{
+  uint32_t x;
+  memcpy (&x, p, sizeof x);
+  return x;
+}
+
+/* Returns the hash table bucket for the 4 bytes X. */
+static inline unsigned
+hash4 (uint32_t x)
+{
+  return (x * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* Appends LEN, the part of a length beyond RUN_MASK, to *OP,
+   without passing OEND.  Returns false if it doesn't fit. */
+static bool
+put_length (uint8_t **op, uint8_t *oend, size_t len)
+{
+  for (; len >= 255; len -= 255)
+    {
+      if (*op >= oend)
+        return false;
+      *(*op)++ = 255;
+    }
+  if (*op >= oend)
+    return false;
+  *(*op)++ = len;
+  return true;
+}
+
+/* Appends a sequence to *OP, without passing OEND: LIT_LEN
+   literal bytes from LIT and then, if MATCH_LEN is nonzero, a
+   match of MATCH_LEN bytes OFFSET bytes back.  Returns false if
+   it doesn't fit. */
+static bool
+put_sequence (uint8_t **op, uint8_t *oend, const uint8_t *lit,
+              size_t lit_len, size_t offset, size_t match_len)
+{
+  uint8_t *token = *op;
+  size_t ml = match_len > 0 ? match_len - MIN_MATCH : 0;
+
+  if (*op >= oend)
+    return false;
+  (*op)++;
+  *token = ((lit_len < RUN_MASK ? lit_len : RUN_MASK) << 4
+            | (ml < RUN_MASK ? ml : RUN_MASK));
+  if (lit_len >= RUN_MASK && !put_length (op, oend, lit_len - RUN_MASK))
+    return false;
+
+  if ((size_t) (oend - *op) < lit_len)
+    return false;
+  memcpy (*op, lit, lit_len);
+  *op += lit_len;
+
+  if (match_len > 0)
+    {
+      if (oend - *op < 2)
+        return false;
+      *(*op)++ = offset & 0xff;
+      *(*op)++ = offset >> 8;
+      if (ml >= RUN_MASK && !put_length (op, oend, ml - RUN_MASK))
+        return false;
+    }
+  return true;
+}
+
+/* Compresses the SIZE bytes at SRC into the DST_SIZE bytes at
+   DST, using the LZ_WORK_SIZE bytes at WORK as scratch space.
+   SIZE must be at most LZ_MAX_INPUT.  Returns the number of
+   bytes of output, or 0 if it would not fit in DST_SIZE
+   bytes. */
+size_t
+lz_compress (const void *src_, size_t size, void *dst_, size_t dst_size,
+             void *work)
+{
+  const uint8_t *src = src_;
+  const uint8_t *ip = src;
+  const uint8_t *anchor = src;
+  const uint8_t *end = src + size;
+  uint8_t *dst = dst_;
+  uint8_t *op = dst;
+  uint8_t *oend = dst + dst_size;
+  uint16_t *table = work;
+
+  ASSERT (size <= LZ_MAX_INPUT);
+
+  /* Each bucket holds 1 + the offset in SRC of the last 4 bytes
+     that hashed to it, or 0 if none did. */
+  memset (table, 0, LZ_WORK_SIZE);
+
+  while (end - ip >= MIN_MATCH)
+    {
+      uint32_t x = read32 (ip);
+      uint16_t *bucket = &table[hash4 (x)];
+      const uint8_t *ref = *bucket != 0 ? src + *bucket - 1 : NULL;
+
+      *bucket = ip - src + 1;
+      if (ref != NULL && ip - ref <= MAX_OFFSET && read32 (ref) == x)
+        {
+          size_t len = MIN_MATCH;
+          while (ip + len < end && ref[len] == ip[len])
+            len++;
+
+          if (!put_sequence (&op, oend, anchor, ip - anchor, ip - ref, len))
+            return 0;
+          ip += len;
+          anchor = ip;
+        }
+      else
+        ip++;
+    }
+
+  if (!put_sequence (&op, oend, anchor, end - anchor, 0, 0))
+    return 0;
+  return op - dst;
+}
+
+/* Reads a length that continues past RUN_MASK from *IP, without
+   passing IEND, and adds it to *LEN.  Returns false if the input
+   ends first. */
+static bool
+get_length (const uint8_t **ip, const uint8_t *iend, size_t *len)
+{
+  uint8_t b;
+
+  do
+    {
+      if (*ip >= iend)
+        return false;
+      b = *(*ip)++;
+      *len += b;
+    }
+  while (b == 255);
+  return true;
+}
+
+/* Decompresses the SIZE bytes at SRC, produced by
+   lz_compress(), into the DST_SIZE bytes at DST.  Returns the
+   number of bytes of output, or LZ_ERROR if SRC is malformed or
+   its output would not fit. */
+size_t
+lz_decompress (const void *src_, size_t size, void *dst_, size_t dst_size)
+{
+  const uint8_t *ip = src_;
+  const uint8_t *iend = ip + size;
+  uint8_t *dst = dst_;
+  uint8_t *op = dst;
+  uint8_t *oend = dst + dst_size;
+
+  while (ip < iend)
+    {
+      uint8_t token = *ip++;
+      size_t lit_len = token >> 4;
+      size_t match_len = token & RUN_MASK;
+      size_t offset;
+
+      if (lit_len == RUN_MASK && !get_length (&ip, iend, &lit_len))
+        return LZ_ERROR;
+      if ((size_t) (iend - ip) < lit_len || (size_t) (oend - op) < lit_len)
+        return LZ_ERROR;
+      memcpy (op, ip, lit_len);
+      ip += lit_len;
+      op += lit_len;
+      if (ip == iend)
+        break;
+
+      if (iend - ip < 2)
+        return LZ_ERROR;
+      offset = ip[0] | (ip[1] << 8);
+      ip += 2;
+      if (match_len == RUN_MASK && !get_length (&ip, iend, &match_len))
+        return LZ_ERROR;
+      match_len += MIN_MATCH;
+      if (offset == 0 || offset > (size_t) (op - dst)
+          || (size_t) (oend - op) < match_len)
+        return LZ_ERROR;
+
+      /* The match may overlap the bytes it produces, so copy a
+         byte at a time. */
+      for (; match_len > 0; match_len--, op++)
+        *op = op[-offset];
+    }
+  return op - dst;
+}
@@ -0,0 +1,27 @@
+#ifndef __LIB_KERNEL_LZ_H
+#define __LIB_KERNEL_LZ_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* LZ77-family compression of small buffers.
+
+   Fast and simple rather than thorough: meant for compressing
+   pages in memory, not files. */
+
+/* Largest input that lz_compress() accepts. */
+#define LZ_MAX_INPUT 65535
+
+/* Number of bytes of scratch space that lz_compress() needs. */
+#define LZ_HASH_BITS 12
+#define LZ_WORK_SIZE ((1 << LZ_HASH_BITS) * sizeof (uint16_t))
+
+/* Returned by lz_decompress() for malformed input. */
+#define LZ_ERROR SIZE_MAX
+
+size_t lz_compress (const void *src, size_t size, void *dst, size_t dst_size,
+                    void *work);
+size_t lz_decompress (const void *src, size_t size, void *dst,
+                      size_t dst_size);
+
+#endif /* lib/kernel/lz.h */
@@ -0,0 +1,25 @@
+#ifndef __LIB_MEMSTAT_H
+#define __LIB_MEMSTAT_H
+
+/* Kernel memory usage charged to one allocation tag, as
+   reported by the memstat system call. */
+struct memstat
+  {
+    char name[16];              /* Tag name, null-terminated. */
+    unsigned pages;             /* Pages allocated now. */
+    unsigned peak_pages;        /* Most pages ever allocated at once. */
+    unsigned bytes;             /* malloc() bytes allocated now. */
+    unsigned peak_bytes;        /* Most malloc() bytes ever at once. */
+  };
+
+/* A process's memory footprint, as reported by the vmstat
+   system call.  All figures are in pages. */
+struct vmstat
+  {
+    unsigned rss;               /* Pages resident now. */
+    unsigned peak_rss;          /* Most pages resident at once. */
+    unsigned working_set;       /* Pages used in the last few seconds. */
+    unsigned rss_limit;         /* RSS limit, or 0 if none. */
+  };
+
+#endif /* lib/memstat.h */
@@ -0,0 +1,50 @@
+#ifndef __LIB_RING_H
+#define __LIB_RING_H
+
+#include <stdint.h>
+
+/* A ring of queued system calls, shared between a user process
+   and the kernel.
+
+   The process puts system calls in the submission queue SQ and
+   then makes one ring_enter system call, which carries out all
+   of them in order and puts their results in the completion
+   queue CQ.  Only calls that work on files may be queued: see
+   sys_ring_enter() and the syscalls table in userprog/syscall.c
+   for the list.
+
+   The four indexes count up forever and are reduced modulo
+   RING_SIZE to find a slot.  The process owns SQ_TAIL and
+   CQ_HEAD; the kernel owns SQ_HEAD and CQ_TAIL.  A queue is
+   empty when its head equals its tail. */
+
+/* Number of slots in each queue.  Must be a power of 2. */
+#define RING_SIZE 32
+
+/* A queued system call. */
+struct ring_sqe
+  {
+    unsigned number;            /* System call number, e.g. SYS_READ. */
+    uint32_t args[3];           /* Arguments. */
+    uint32_t user_data;         /* Copied to the completion. */
+  };
+
+/* A finished system call. */
+struct ring_cqe
+  {
+    uint32_t user_data;         /* From the submission. */
+    int32_t result;             /* Return value, or -1 if not allowed. */
+  };
+
+/* A submission/completion ring. */
+struct ring
+  {
+    unsigned sq_head;           /* Next submission for the kernel. */
+    unsigned sq_tail;           /* Next free submission slot. */
+    unsigned cq_head;           /* Next completion for the process. */
+    unsigned cq_tail;           /* Next free completion slot. */
+    struct ring_sqe sq[RING_SIZE]; /* Submission queue. */
+    struct ring_cqe cq[RING_SIZE]; /* Completion queue. */
+  };
+
+#endif /* lib/ring.h */
@@ -28,7 +28,15 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Extensions. */
+    SYS_MEMSTAT,                /* Reports kernel memory usage. */
+    SYS_FORK,                   /* Duplicate this process. */
+    SYS_VMSTAT,                 /* Reports this process's memory use. */
+    SYS_RSSLIMIT,               /* Limits this process's resident set. */
+    SYS_MMAP_ANON,              /* Map zeroed memory. */
+    SYS_RING_ENTER              /* Carry out queued system calls. */
   };
 
 #endif /* lib/syscall-nr.h */
@@ -2,7 +2,10 @@
 #define __LIB_USER_SYSCALL_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <debug.h>
+#include <memstat.h>
+#include <ring.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -12,6 +15,9 @@ typedef int pid_t;
 typedef int mapid_t;
 #define MAP_FAILED ((mapid_t) -1)
 
+/* Flags for mmap_anon(). */
+#define MAP_LARGE 0x1           /* Use 4 MB pages where possible. */
+
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
@@ -37,6 +43,7 @@ void close (int fd);
 /* Project 3 and optionally project 4. */
 mapid_t mmap (int fd, void *addr);
 void munmap (mapid_t);
+mapid_t mmap_anon (void *addr, size_t size, int flags);
 
 /* Project 4 only. */
 bool chdir (const char *dir);
@@ -45,4 +52,11 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+bool memstat (int tag, struct memstat *);
+pid_t fork (void);
+void vmstat (struct vmstat *);
+int rsslimit (int pages);
+int ring_enter (struct ring *);
+
 #endif /* lib/user/syscall.h */
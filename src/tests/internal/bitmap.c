@@ -0,0 +1,154 @@
+/* Test program for lib/kernel/bitmap.c.
+
+   Checks bitmap_scan(), bitmap_count(), and bitmap_contains()
+   against simple bit-at-a-time reference versions on random
+   bitmaps, then times scans of bitmaps that are nearly full,
+   which is the worst case for the page allocator and the free
+   map.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <bitmap.h>
+#include <debug.h>
+#include <random.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/test.h"
+
+/* Largest bitmap that we test. */
+#define MAX_BITS 4096
+
+/* Number of bits in the bitmaps that we time. */
+#define BENCH_BITS 65536
+
+/* Number of scans per timing. */
+#define BENCH_SCANS 1000
+
+static void test_random (size_t bit_cnt, int density);
+static size_t ref_scan (const struct bitmap *, size_t start, size_t cnt,
+                        bool);
+static void bench (int free_per_mille);
+
+/* Test the bitmap implementation. */
+void
+test (void)
+{
+  size_t bit_cnt;
+
+  printf ("testing various size bitmaps:");
+  for (bit_cnt = 0; bit_cnt <= MAX_BITS; bit_cnt = bit_cnt * 4 / 3 + 1)
+    {
+      int density;
+
+      printf (" %zu", bit_cnt);
+      for (density = 0; density <= 100; density += 10)
+        test_random (bit_cnt, density);
+    }
+  printf (" done\n");
+
+  printf ("%10s %8s %8s %8s %8s (timer ticks per %d scans)\n",
+          "free bits", "cnt=1", "cnt=2", "cnt=8", "count", BENCH_SCANS);
+  bench (100);
+  bench (10);
+  bench (1);
+  bench (0);
+  printf ("bitmap: PASS\n");
+}
+
+/* Checks the bitmap functions on a bitmap of BIT_CNT bits, each
+   set with a DENSITY percent probability. */
+static void
+test_random (size_t bit_cnt, int density)
+{
+  struct bitmap *b = bitmap_create (bit_cnt);
+  int i;
+
+  ASSERT (b != NULL);
+  for (i = 0; (size_t) i < bit_cnt; i++)
+    bitmap_set (b, i, (int) (random_ulong () % 100) < density);
+
+  for (i = 0; i < 100; i++)
+    {
+      size_t start = random_ulong () % (bit_cnt + 1);
+      size_t cnt = random_ulong () % (bit_cnt - start + 1);
+      size_t group = random_ulong () % 16;
+      bool value = random_ulong () % 2;
+      size_t true_cnt = 0;
+      size_t j;
+
+      for (j = start; j < start + cnt; j++)
+        true_cnt += bitmap_test (b, j);
+      ASSERT (bitmap_count (b, start, cnt, true) == true_cnt);
+      ASSERT (bitmap_count (b, start, cnt, false) == cnt - true_cnt);
+      ASSERT (bitmap_contains (b, start, cnt, true) == (true_cnt > 0));
+      ASSERT (bitmap_contains (b, start, cnt, false) == (true_cnt < cnt));
+      ASSERT (bitmap_scan (b, start, group, value)
+              == ref_scan (b, start, group, value));
+    }
+
+  bitmap_destroy (b);
+}
+
+/* Reference version of bitmap_scan(). */
+static size_t
+ref_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
+{
+  size_t i, j;
+
+  if (cnt == 0)
+    return start;
+  for (i = start; i + cnt <= bitmap_size (b); i++)
+    {
+      for (j = 0; j < cnt; j++)
+        if (bitmap_test (b, i + j) != value)
+          break;
+      if (j == cnt)
+        return i;
+    }
+  return BITMAP_ERROR;
+}
+
+/* Times scans for groups of free (false) bits in a bitmap of
+   BENCH_BITS bits, of which FREE_PER_MILLE out of every 1000
+   are free and never adjacent, so that no group of more than
+   one bit exists. */
+static void
+bench (int free_per_mille)
+{
+  static const size_t groups[] = {1, 2, 8};
+  struct bitmap *b = bitmap_create (BENCH_BITS);
+  int64_t ticks[4];
+  int64_t start;
+  size_t free_cnt;
+  size_t i, g;
+
+  ASSERT (b != NULL);
+  bitmap_set_all (b, true);
+  free_cnt = 0;
+  if (free_per_mille > 0)
+    for (i = 0; i < BENCH_BITS; i += 1000 / free_per_mille)
+      {
+        bitmap_reset (b, i);
+        free_cnt++;
+      }
+
+  for (g = 0; g < sizeof groups / sizeof *groups; g++)
+    {
+      start = timer_ticks ();
+      for (i = 0; i < BENCH_SCANS; i++)
+        bitmap_scan (b, 0, groups[g], false);
+      ticks[g] = timer_elapsed (start);
+    }
+
+  start = timer_ticks ();
+  for (i = 0; i < BENCH_SCANS; i++)
+    ASSERT (bitmap_count (b, 0, BENCH_BITS, false) == free_cnt);
+  ticks[3] = timer_elapsed (start);
+
+  printf ("%10zu %8lld %8lld %8lld %8lld\n",
+          free_cnt, ticks[0], ticks[1], ticks[2], ticks[3]);
+  bitmap_destroy (b);
+}
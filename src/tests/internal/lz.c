@@ -0,0 +1,143 @@
+/* Test program for lib/kernel/lz.c.
+
+   Compresses and decompresses random buffers of various sizes
+   and kinds of contents, from incompressible to all zeros, and
+   checks that each comes back intact, that compression fails
+   cleanly when the output does not fit, and that truncated
+   input is rejected.  Then reports how well typical pages
+   compress.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <lz.h>
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/test.h"
+#include "threads/vaddr.h"
+
+/* Largest buffer that we test. */
+#define MAX_SIZE 8192
+
+/* Room for the compressed form of a MAX_SIZE buffer, which may
+   be a little larger than the buffer itself. */
+#define MAX_OUT (MAX_SIZE + MAX_SIZE / 255 + 16)
+
+/* Kinds of buffer contents. */
+enum fill
+  {
+    FILL_RANDOM,                /* Random bytes. */
+    FILL_ZERO,                  /* All zeros. */
+    FILL_RUNS,                  /* Runs of repeated bytes. */
+    FILL_TEXT,                  /* Few distinct bytes. */
+    FILL_CNT
+  };
+
+static uint8_t *src, *cmp, *out;
+static void *work;
+
+static void fill (uint8_t *, size_t, enum fill);
+static void test_roundtrip (size_t size, enum fill);
+static void report (enum fill, const char *name);
+
+/* Test the compressor. */
+void
+test (void)
+{
+  size_t size;
+  int f;
+
+  src = malloc (MAX_SIZE);
+  cmp = malloc (MAX_OUT);
+  out = malloc (MAX_SIZE);
+  work = malloc (LZ_WORK_SIZE);
+  ASSERT (src != NULL && cmp != NULL && out != NULL && work != NULL);
+
+  printf ("testing various size buffers:");
+  for (size = 0; size <= MAX_SIZE; size = size * 3 / 2 + 1)
+    {
+      int i;
+
+      printf (" %zu", size);
+      for (i = 0; i < 10; i++)
+        for (f = 0; f < FILL_CNT; f++)
+          test_roundtrip (size, f);
+    }
+  printf (" done\n");
+
+  report (FILL_RANDOM, "random");
+  report (FILL_ZERO, "zero");
+  report (FILL_RUNS, "runs");
+  report (FILL_TEXT, "text");
+
+  free (src);
+  free (cmp);
+  free (out);
+  free (work);
+  printf ("lz: PASS\n");
+}
+
+/* Fills the SIZE bytes at P with contents of kind F. */
+static void
+fill (uint8_t *p, size_t size, enum fill f)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    switch (f)
+      {
+      case FILL_RANDOM:
+        p[i] = random_ulong ();
+        break;
+      case FILL_ZERO:
+        p[i] = 0;
+        break;
+      case FILL_RUNS:
+        p[i] = i > 0 && random_ulong () % 16 ? p[i - 1] : random_ulong ();
+        break;
+      default:
+        p[i] = "etaoin "[random_ulong () % 7];
+        break;
+      }
+}
+
+/* Checks compression and decompression of a SIZE-byte buffer
+   with contents of kind F. */
+static void
+test_roundtrip (size_t size, enum fill f)
+{
+  size_t cmp_size;
+
+  fill (src, size, f);
+  cmp_size = lz_compress (src, size, cmp, MAX_OUT, work);
+  ASSERT (cmp_size > 0 && cmp_size <= MAX_OUT);
+
+  memset (out, 0xcc, MAX_SIZE);
+  ASSERT (lz_decompress (cmp, cmp_size, out, MAX_SIZE) == size);
+  ASSERT (!memcmp (src, out, size));
+
+  /* Output one byte too small must fail, not overrun. */
+  ASSERT (lz_compress (src, size, cmp, cmp_size - 1, work) == 0);
+  ASSERT (lz_compress (src, size, cmp, MAX_OUT, work) == cmp_size);
+
+  /* So must a buffer one byte too small to decompress into. */
+  if (size > 0) 
+    {
+      ASSERT (lz_decompress (cmp, cmp_size, out, size - 1) == LZ_ERROR);
+    }
+}
+
+/* Prints the size to which a page with contents of kind F,
+   called NAME, compresses. */
+static void
+report (enum fill f, const char *name)
+{
+  fill (src, PGSIZE, f);
+  printf ("%s page: %zu bytes compressed\n", name,
+          lz_compress (src, PGSIZE, cmp, MAX_OUT, work));
+}
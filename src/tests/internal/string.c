@@ -0,0 +1,359 @@
+/* Test program for lib/string.c.
+
+   Checks memcpy(), memmove(), memset(), and memcmp() against
+   simple byte-at-a-time reference versions for many sizes and
+   alignments, then times each of them for block sizes from 1
+   byte to 64 kB.  Does the same for strlen(), strchr(),
+   strcmp(), strlcpy(), and memchr(), including strings that
+   end at the last byte of a page.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <random.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/palloc.h"
+#include "threads/test.h"
+#include "threads/vaddr.h"
+
+/* Largest block that we test or time. */
+#define MAX_SIZE 65536
+
+/* Extra room for misaligning blocks. */
+#define SLACK 16
+
+/* Number of bytes to push through each function per block size
+   when timing. */
+#define BENCH_BYTES (16 * 1024 * 1024)
+
+static uint8_t src_buf[MAX_SIZE + 2 * SLACK];
+static uint8_t dst_buf[MAX_SIZE + 2 * SLACK];
+static uint8_t ref_buf[MAX_SIZE + 2 * SLACK];
+
+static void test_memcpy (size_t size, size_t dst_ofs, size_t src_ofs);
+static void test_memmove (size_t size, size_t dst_ofs, size_t src_ofs);
+static void test_memset (size_t size, size_t ofs);
+static void test_memcmp (size_t size, size_t ofs);
+static void test_strings (size_t len, size_t ofs);
+static void test_page_end (void);
+static void bench (void);
+static void bench_strings (void);
+
+/* Test the block function implementations. */
+void
+test (void)
+{
+  size_t size;
+
+  printf ("testing various block sizes:");
+  for (size = 0; size <= MAX_SIZE; size = size * 5 / 4 + 1)
+    {
+      size_t a, b;
+
+      printf (" %zu", size);
+      for (a = 0; a < 8; a++)
+        {
+          for (b = 0; b < 8; b++)
+            {
+              test_memcpy (size, a, b);
+              test_memmove (size, a, b);
+            }
+          test_memset (size, a);
+          test_memcmp (size, a);
+        }
+    }
+  printf (" done\n");
+
+  printf ("testing various string lengths:");
+  for (size = 0; size < MAX_SIZE; size = size * 5 / 4 + 1)
+    {
+      size_t ofs;
+
+      printf (" %zu", size);
+      for (ofs = 0; ofs < 8; ofs++)
+        test_strings (size, ofs);
+    }
+  test_page_end ();
+  printf (" done\n");
+
+  bench ();
+  bench_strings ();
+  printf ("string: PASS\n");
+}
+
+/* Fills BUF with SIZE random bytes. */
+static void
+fill_random (uint8_t *buf, size_t size)
+{
+  random_bytes (buf, size);
+}
+
+/* Checks memcpy() of SIZE bytes between blocks at the given
+   offsets from the start of their buffers. */
+static void
+test_memcpy (size_t size, size_t dst_ofs, size_t src_ofs)
+{
+  size_t i;
+
+  fill_random (src_buf, sizeof src_buf);
+  fill_random (dst_buf, sizeof dst_buf);
+  for (i = 0; i < sizeof dst_buf; i++)
+    ref_buf[i] = dst_buf[i];
+  for (i = 0; i < size; i++)
+    ref_buf[dst_ofs + i] = src_buf[src_ofs + i];
+
+  ASSERT (memcpy (dst_buf + dst_ofs, src_buf + src_ofs, size)
+          == dst_buf + dst_ofs);
+  for (i = 0; i < sizeof dst_buf; i++)
+    ASSERT (dst_buf[i] == ref_buf[i]);
+}
+
+/* Checks memmove() of SIZE bytes within a single buffer, in
+   both directions, with the blocks overlapping whenever SIZE is
+   larger than the distance between the offsets. */
+static void
+test_memmove (size_t size, size_t dst_ofs, size_t src_ofs)
+{
+  size_t i;
+
+  if (size > MAX_SIZE)
+    return;
+
+  fill_random (dst_buf, sizeof dst_buf);
+  for (i = 0; i < sizeof dst_buf; i++)
+    ref_buf[i] = dst_buf[i];
+  for (i = 0; i < size; i++)
+    src_buf[i] = ref_buf[src_ofs + i];
+  for (i = 0; i < size; i++)
+    ref_buf[dst_ofs + i] = src_buf[i];
+
+  ASSERT (memmove (dst_buf + dst_ofs, dst_buf + src_ofs, size)
+          == dst_buf + dst_ofs);
+  for (i = 0; i < sizeof dst_buf; i++)
+    ASSERT (dst_buf[i] == ref_buf[i]);
+}
+
+/* Checks memset() of SIZE bytes at OFS. */
+static void
+test_memset (size_t size, size_t ofs)
+{
+  int value = random_ulong () & 0xff;
+  size_t i;
+
+  fill_random (dst_buf, sizeof dst_buf);
+  for (i = 0; i < sizeof dst_buf; i++)
+    ref_buf[i] = i >= ofs && i < ofs + size ? value : dst_buf[i];
+
+  ASSERT (memset (dst_buf + ofs, value, size) == dst_buf + ofs);
+  for (i = 0; i < sizeof dst_buf; i++)
+    ASSERT (dst_buf[i] == ref_buf[i]);
+}
+
+/* Checks memcmp() of SIZE bytes at OFS in two buffers that are
+   equal, and then that differ in a single random byte. */
+static void
+test_memcmp (size_t size, size_t ofs)
+{
+  size_t pos;
+
+  fill_random (src_buf, sizeof src_buf);
+  memcpy (dst_buf, src_buf, sizeof dst_buf);
+  ASSERT (memcmp (dst_buf + ofs, src_buf + ofs, size) == 0);
+  if (size == 0)
+    return;
+
+  pos = ofs + random_ulong () % size;
+  if (src_buf[pos] == 0xff)
+    src_buf[pos] = 0;
+  dst_buf[pos] = src_buf[pos] + 1;
+  ASSERT (memcmp (dst_buf + ofs, src_buf + ofs, size) > 0);
+  ASSERT (memcmp (src_buf + ofs, dst_buf + ofs, size) < 0);
+}
+
+/* Fills the LEN bytes at STRING with random nonzero bytes and
+   adds a null terminator. */
+static void
+make_string (char *string, size_t len)
+{
+  size_t i;
+
+  for (i = 0; i < len; i++)
+    string[i] = random_ulong () % 255 + 1;
+  string[len] = '\0';
+}
+
+/* Checks the string functions on a string of LEN characters at
+   OFS in SRC_BUF. */
+static void
+test_strings (size_t len, size_t ofs)
+{
+  char *s = (char *) src_buf + ofs;
+  char *t = (char *) dst_buf + (len + ofs) % 8;
+  char c;
+  size_t i, pos;
+
+  make_string (s, len);
+  ASSERT (strlen (s) == len);
+  ASSERT (strnlen (s, len / 2) == len / 2);
+  ASSERT (strchr (s, '\0') == s + len);
+
+  /* Search for a character that appears only at POS. */
+  pos = len > 0 ? random_ulong () % len : 0;
+  c = len > 0 ? s[pos] : 'x';
+  for (i = 0; i < len; i++)
+    if (s[i] == c && i != pos)
+      s[i] = c == 'y' ? 'z' : 'y';
+  ASSERT (strchr (s, c) == (len > 0 ? s + pos : NULL));
+  ASSERT (memchr (s, c, len) == (len > 0 ? s + pos : NULL));
+  ASSERT (memchr (s, c, pos) == NULL);
+
+  /* Copy, then compare equal and unequal strings. */
+  ASSERT (strlcpy (t, s, len + 1) == len);
+  ASSERT (strcmp (t, s) == 0);
+  if (len > 0)
+    {
+      ASSERT (strlcpy (t, s, pos + 1) == len);
+      ASSERT (strlen (t) == pos);
+      ASSERT (strcmp (t, s) < 0);
+      ASSERT (strcmp (s, t) > 0);
+
+      strlcpy (t, s, len + 1);
+      t[pos] = (unsigned char) s[pos] == 0xff ? 1 : s[pos] + 1;
+      ASSERT ((strcmp (t, s) > 0) == ((unsigned char) t[pos]
+                                      > (unsigned char) s[pos]));
+    }
+}
+
+/* Checks the string functions on strings whose terminators are
+   the last byte of a page, compared against copies at every
+   alignment. */
+static void
+test_page_end (void)
+{
+  uint8_t *page = palloc_get_page (PAL_ASSERT);
+  size_t len;
+
+  for (len = 0; len < 64; len++)
+    {
+      char *s = (char *) page + PGSIZE - 1 - len;
+      size_t ofs;
+
+      make_string (s, len);
+      ASSERT (strlen (s) == len);
+      ASSERT (strchr (s, '\0') == s + len);
+      for (ofs = 0; ofs < 8; ofs++)
+        {
+          char *t = (char *) dst_buf + ofs;
+
+          ASSERT (strlcpy (t, s, len + 1) == len);
+          ASSERT (strcmp (s, t) == 0);
+          ASSERT (strcmp (t, s) == 0);
+        }
+    }
+  palloc_free_page (page);
+}
+
+/* Prints the number of timer ticks taken to process
+   BENCH_BYTES bytes with each block function, for block sizes
+   from 1 byte to MAX_SIZE bytes. */
+static void
+bench (void)
+{
+  size_t size;
+
+  printf ("%8s %8s %8s %8s %8s (timer ticks per %d MB)\n",
+          "size", "memcpy", "memmove", "memset", "memcmp",
+          BENCH_BYTES / 1024 / 1024);
+  for (size = 1; size <= MAX_SIZE; size *= 2)
+    {
+      size_t iterations = BENCH_BYTES / size;
+      int64_t start;
+      int64_t ticks[4];
+      size_t i;
+
+      start = timer_ticks ();
+      for (i = 0; i < iterations; i++)
+        memcpy (dst_buf, src_buf, size);
+      ticks[0] = timer_elapsed (start);
+
+      start = timer_ticks ();
+      for (i = 0; i < iterations; i++)
+        memmove (dst_buf + 1, dst_buf, size);
+      ticks[1] = timer_elapsed (start);
+
+      start = timer_ticks ();
+      for (i = 0; i < iterations; i++)
+        memset (dst_buf, i, size);
+      ticks[2] = timer_elapsed (start);
+
+      memcpy (dst_buf, src_buf, size);
+      start = timer_ticks ();
+      for (i = 0; i < iterations; i++)
+        ASSERT (memcmp (dst_buf, src_buf, size) == 0);
+      ticks[3] = timer_elapsed (start);
+
+      printf ("%8zu %8lld %8lld %8lld %8lld\n",
+              size, ticks[0], ticks[1], ticks[2], ticks[3]);
+    }
+}
+
+/* Prints the number of timer ticks taken to process
+   BENCH_BYTES bytes with each string function, for string
+   lengths from 1 byte to MAX_SIZE - 1 bytes. */
+static void
+bench_strings (void)
+{
+  size_t size;
+
+  printf ("%8s %8s %8s %8s %8s %8s (timer ticks per %d MB)\n",
+          "length", "strlen", "strchr", "strcmp", "strlcpy", "memchr",
+          BENCH_BYTES / 1024 / 1024);
+  for (size = 2; size <= MAX_SIZE; size *= 2)
+    {
+      char *s = (char *) src_buf;
+      char *t = (char *) dst_buf;
+      size_t len = size - 1;
+      size_t iterations = BENCH_BYTES / size;
+      int64_t start;
+      int64_t ticks[5];
+      size_t i;
+
+      memset (s, 'x', len);
+      s[len] = '\0';
+      strlcpy (t, s, size);
+
+      start = timer_ticks ();
+      for (i = 0; i < iterations; i++)
+        ASSERT (strlen (s) == len);
+      ticks[0] = timer_elapsed (start);
+
+      start = timer_ticks ();
+      for (i = 0; i < iterations; i++)
+        ASSERT (strchr (s, 'y') == NULL);
+      ticks[1] = timer_elapsed (start);
+
+      start = timer_ticks ();
+      for (i = 0; i < iterations; i++)
+        ASSERT (strcmp (s, t) == 0);
+      ticks[2] = timer_elapsed (start);
+
+      start = timer_ticks ();
+      for (i = 0; i < iterations; i++)
+        strlcpy (t, s, size);
+      ticks[3] = timer_elapsed (start);
+
+      start = timer_ticks ();
+      for (i = 0; i < iterations; i++)
+        ASSERT (memchr (s, 'y', len) == NULL);
+      ticks[4] = timer_elapsed (start);
+
+      printf ("%8zu %8lld %8lld %8lld %8lld %8lld\n", len,
+              ticks[0], ticks[1], ticks[2], ticks[3], ticks[4]);
+    }
+}
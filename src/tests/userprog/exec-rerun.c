@@ -0,0 +1,12 @@
+/* Does nothing but start and stop.  The kernel command line runs
+   this program three times in a row, and the kernel should parse
+   its headers only the first time, even though no process has
+   the file open between runs. */
+
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+}
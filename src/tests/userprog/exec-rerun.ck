@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+my ($exits) = scalar (grep (/^exec-rerun: exit\(0\)$/, @output));
+fail "exec-rerun should have run 3 times, but exited $exits times\n"
+  if $exits != 3;
+
+my ($hits) = map (/^Exec: \d+ loads, (\d+) from header cache/, @output);
+fail "missing \"Exec:\" statistics\n" if !defined $hits;
+fail "exec-rerun was parsed again on each run ($hits cache hits)\n"
+  if $hits < 2;
+
+check_expected ([<<'EOF']);
+(exec-rerun) begin
+(exec-rerun) end
+exec-rerun: exit(0)
+EOF
+pass;
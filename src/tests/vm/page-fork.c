@@ -0,0 +1,71 @@
+/* Forks while a page of data is shared copy-on-write, then has
+   parent and child each fill their copy with different bytes
+   and check that they still see their own.  The two processes
+   take turns through a memory-mapped file, which fork() shares
+   between them. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SYNC ((volatile char *) 0x10000000)
+
+/* Indexes into SYNC. */
+enum
+  {
+    CHILD_WROTE,                /* Child has filled its copy. */
+    PARENT_WROTE,               /* Parent has filled its copy. */
+    CHILD_RESULT                /* 'y' or 'n': child's copy intact? */
+  };
+
+static char buf[4096];
+
+/* Waits until SYNC[IDX] is nonzero, and returns it. */
+static char
+await (int idx)
+{
+  while (SYNC[idx] == 0)
+    continue;
+  return SYNC[idx];
+}
+
+/* Returns true if every byte of BUF is C. */
+static bool
+all_bytes (char c)
+{
+  size_t i;
+
+  for (i = 0; i < sizeof buf; i++)
+    if (buf[i] != c)
+      return false;
+  return true;
+}
+
+void
+test_main (void)
+{
+  int handle;
+  pid_t pid;
+
+  CHECK (create ("sync", sizeof buf), "create \"sync\"");
+  CHECK ((handle = open ("sync")) > 1, "open \"sync\"");
+  CHECK (mmap (handle, (void *) SYNC) != MAP_FAILED, "mmap \"sync\"");
+
+  memset (buf, 'a', sizeof buf);
+  CHECK ((pid = fork ()) != -1, "fork");
+  if (pid == 0)
+    {
+      memset (buf, 'c', sizeof buf);
+      SYNC[CHILD_WROTE] = 1;
+      await (PARENT_WROTE);
+      SYNC[CHILD_RESULT] = all_bytes ('c') ? 'y' : 'n';
+      exit (0);
+    }
+
+  memset (buf, 'p', sizeof buf);
+  SYNC[PARENT_WROTE] = 1;
+  await (CHILD_WROTE);
+  CHECK (all_bytes ('p'), "parent sees its own data");
+  CHECK (await (CHILD_RESULT) == 'y', "child sees its own data");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-fork) begin
+(page-fork) create "sync"
+(page-fork) open "sync"
+(page-fork) mmap "sync"
+(page-fork) fork
+(page-fork) parent sees its own data
+(page-fork) child sees its own data
+(page-fork) end
+EOF
+pass;
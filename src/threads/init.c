@@ -15,6 +15,7 @@
 #include "devices/timer.h"
 #include "devices/vga.h"
 #include "devices/rtc.h"
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
@@ -37,6 +38,14 @@
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
+#ifdef VM
+#include "vm/cache.h"
+#include "vm/frame.h"
+#include "vm/merge.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+#include "vm/zswap.h"
+#endif
 
 /* Page directory with kernel mappings only. */
 uint32_t *init_page_dir;
@@ -98,6 +107,11 @@ main (void)
   palloc_init (user_page_limit);
   malloc_init ();
   paging_init ();
+#ifdef VM
+  frame_init ();
+  cache_init ();
+  page_init ();
+#endif
 
   /* Segmentation. */
 #ifdef USERPROG
@@ -127,6 +141,12 @@ main (void)
   filesys_init (format_filesys);
 #endif
 
+#ifdef VM
+  swap_init ();
+  frame_start ();
+  merge_start ();
+#endif
+
   printf ("Boot complete.\n");
   
   /* Run actions specified on kernel command line. */
@@ -153,15 +173,28 @@ bss_init (void)
 /* Populates the base page directory and page table with the
    kernel virtual mapping, and then sets up the CPU to use the
    new page directory.  Points init_page_dir to the page
-   directory it creates. */
+   directory it creates.
+
+   If the CPU supports them, each whole 4 MB of RAM that holds
+   no kernel text is mapped with a single large-page PDE, which
+   saves a page table per 4 MB and lets one TLB entry cover the
+   whole region.  The region holding the kernel text, and any
+   partial 4 MB at the end of RAM, keep ordinary page tables so
+   that the text can be mapped read-only. */
 static void
 paging_init (void)
 {
   uint32_t *pd, *pt;
   size_t page;
   extern char _start, _end_kernel_text;
+  bool use_large = cpu_has (CPUID_PSE);
+  uint32_t global = cpu_has (CPUID_PGE) ? PTE_G : 0;
+
+  if (use_large)
+    cr4_set (CR4_PSE);
 
-  pd = init_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+  pd = init_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO
+                                        | PAL_TAG (MEM_PAGEDIR));
   pt = NULL;
   for (page = 0; page < init_ram_pages; page++)
     {
@@ -173,11 +206,24 @@ paging_init (void)
 
       if (pd[pde_idx] == 0)
         {
-          pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+          bool has_kernel_text = vaddr < &_end_kernel_text
+                                 && vaddr + PTSPAN > &_start;
+          size_t large_pages = PTSPAN / PGSIZE;
+
+          if (use_large && !has_kernel_text
+              && paddr % PTSPAN == 0
+              && init_ram_pages - page >= large_pages)
+            {
+              pd[pde_idx] = pde_create_kernel_large (vaddr, true) | global;
+              page += large_pages - 1;
+              continue;
+            }
+
+          pt = palloc_get_page (PAL_ASSERT | PAL_ZERO | PAL_TAG (MEM_PAGEDIR));
           pd[pde_idx] = pde_create (pt);
         }
 
-      pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text);
+      pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text) | global;
     }
 
   /* Store the physical address of the page directory into CR3
@@ -186,6 +232,12 @@ paging_init (void)
      to/from Control Registers" and [IA32-v3a] 3.7.5 "Base Address
      of the Page Directory". */
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)));
+
+  /* Mark the kernel's mappings global, so that they stay in the
+     TLB when CR3 is loaded to switch processes.  They are in
+     every page directory and never change. */
+  if (global)
+    cr4_set (CR4_PGE);
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -256,9 +308,31 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-memtrack"))
+        palloc_track_sites = true;
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+#endif
+#ifdef VM
+      else if (!strcmp (name, "-stack"))
+        page_stack_limit = (size_t) atoi (value) * 1024;
+      else if (!strcmp (name, "-prefault"))
+        page_prefault_limit = (size_t) atoi (value) * 1024;
+      else if (!strcmp (name, "-merge"))
+        merge_rate = atoi (value);
+      else if (!strcmp (name, "-rsslimit"))
+        frame_rss_limit = atoi (value);
+      else if (!strcmp (name, "-rss"))
+        frame_report_rss = true;
+      else if (!strcmp (name, "-zswap"))
+        zswap_size = (size_t) atoi (value) * 1024;
+      else if (!strcmp (name, "-evict"))
+        {
+          if (value == NULL || !frame_set_policy (value))
+            PANIC ("unknown eviction policy `%s' (use -h for help)",
+                   value != NULL ? value : "");
+        }
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -379,8 +453,23 @@ usage (void)
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -memtrack          Record allocation sites and report leaks.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+          "  -stack=KB          Limit user stacks to KB kB (default 8192).\n"
+          "  -prefault=KB       Read in executable segments of up to KB kB when\n"
+          "                     programs are loaded (default 64).\n"
+          "  -evict=POLICY      Evict pages by POLICY: clock (default), lru2,\n"
+          "                     or arc.\n"
+          "  -merge=RATE        Scan RATE frames per second for identical pages\n"
+          "                     to merge (default 0, disabled; try 200).\n"
+          "  -rsslimit=PAGES    Prefer to evict pages of processes with more than\n"
+          "                     PAGES pages resident (default 0, no limit).\n"
+          "  -rss               Report each process's memory use as it exits.\n"
+          "  -zswap=KB          Keep up to KB kB of compressed swap in memory\n"
+          "                     (default 256, 0 to disable).\n"
 #endif
           );
   shutdown_power_off ();
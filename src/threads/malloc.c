@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -32,14 +33,24 @@
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.
+
+   For accounting, each block is charged to a tag (see enum
+   mem_tag in palloc.h).  An arena keeps a byte per block that
+   records the block's tag, between the arena header and the
+   first block, followed by the blocks' allocation sites if
+   palloc_track_sites is true.  A big block's tag is in its
+   arena header. */
 
 /* Descriptor. */
 struct desc
   {
     size_t block_size;          /* Size of each element in bytes. */
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
+    size_t sites_ofs;           /* Offset of sites in an arena, if any. */
+    size_t blocks_ofs;          /* Offset of first block in an arena. */
     struct list free_list;      /* List of free blocks. */
+    struct list arenas;         /* List of arenas. */
     struct lock lock;           /* Lock. */
   };
 
@@ -52,6 +63,8 @@ struct arena
     unsigned magic;             /* Always set to ARENA_MAGIC. */
     struct desc *desc;          /* Owning descriptor, null for big block. */
     size_t free_cnt;            /* Free blocks; pages in big block. */
+    enum mem_tag tag;           /* Tag of a big block. */
+    struct list_elem elem;      /* Element in desc's list of arenas. */
   };
 
 /* Free block. */
@@ -64,22 +77,52 @@ struct block
 static struct desc descs[10];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Bytes charged to each tag: now, and the most at any one time.
+   Protected by disabling interrupts, since they are shared
+   among the descriptors. */
+static size_t tag_bytes[MEM_TAG_CNT];
+static size_t tag_peak_bytes[MEM_TAG_CNT];
+
+static void *tagged_malloc (size_t, enum mem_tag, void *pc);
+static void charge (enum mem_tag, size_t bytes);
+static void credit (enum mem_tag, size_t bytes);
+static enum mem_tag block_tag (void *block);
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static size_t block_idx (struct arena *, struct block *);
+static uint8_t *arena_tags (struct arena *);
+static struct alloc_site *arena_sites (struct arena *);
 
 /* Initializes the malloc() descriptors. */
 void
 malloc_init (void) 
 {
+  size_t site_size = palloc_track_sites ? sizeof (struct alloc_site) : 0;
   size_t block_size;
 
   for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2)
     {
       struct desc *d = &descs[desc_cnt++];
+      size_t cnt;
       ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
+
+      /* Find the most blocks that fit in a page along with their
+         tags and sites. */
+      cnt = (PGSIZE - sizeof (struct arena)) / (block_size + 1 + site_size);
+      for (;; cnt--) 
+        {
+          d->sites_ofs = ROUND_UP (sizeof (struct arena) + cnt,
+                                   sizeof (void *));
+          d->blocks_ofs = ROUND_UP (d->sites_ofs + cnt * site_size,
+                                    sizeof (void *));
+          if (d->blocks_ofs + cnt * block_size <= PGSIZE)
+            break;
+        }
+
       d->block_size = block_size;
-      d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
+      d->blocks_per_arena = cnt;
       list_init (&d->free_list);
+      list_init (&d->arenas);
       lock_init (&d->lock);
     }
 }
@@ -88,10 +131,30 @@ malloc_init (void)
    Returns a null pointer if memory is not available. */
 void *
 malloc (size_t size) 
+{
+  return tagged_malloc (size, MEM_MISC, __builtin_return_address (0));
+}
+
+/* Obtains and returns a new block of at least SIZE bytes,
+   charged to TAG.
+   Returns a null pointer if memory is not available. */
+void *
+malloc_tagged (size_t size, enum mem_tag tag) 
+{
+  return tagged_malloc (size, tag, __builtin_return_address (0));
+}
+
+/* Does the work of malloc_tagged(), recording PC as the
+   allocation site. */
+static void *
+tagged_malloc (size_t size, enum mem_tag tag, void *pc) 
 {
   struct desc *d;
   struct block *b;
   struct arena *a;
+  size_t idx;
+
+  ASSERT (tag < MEM_TAG_CNT);
 
   /* A null pointer satisfies a request for 0 bytes. */
   if (size == 0)
@@ -107,7 +170,7 @@ malloc (size_t size)
       /* SIZE is too big for any descriptor.
          Allocate enough pages to hold SIZE plus an arena. */
       size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
-      a = palloc_get_multiple (0, page_cnt);
+      a = palloc_get_multiple_at (PAL_TAG (tag), page_cnt, pc);
       if (a == NULL)
         return NULL;
 
@@ -116,6 +179,8 @@ malloc (size_t size)
       a->magic = ARENA_MAGIC;
       a->desc = NULL;
       a->free_cnt = page_cnt;
+      a->tag = tag;
+      charge (tag, page_cnt * PGSIZE);
       return a + 1;
     }
 
@@ -127,7 +192,7 @@ malloc (size_t size)
       size_t i;
 
       /* Allocate a page. */
-      a = palloc_get_page (0);
+      a = palloc_get_page (PAL_TAG (MEM_MALLOC));
       if (a == NULL) 
         {
           lock_release (&d->lock);
@@ -138,6 +203,10 @@ malloc (size_t size)
       a->magic = ARENA_MAGIC;
       a->desc = d;
       a->free_cnt = d->blocks_per_arena;
+      list_push_back (&d->arenas, &a->elem);
+      if (palloc_track_sites)
+        memset (arena_sites (a), 0,
+                d->blocks_per_arena * sizeof (struct alloc_site));
       for (i = 0; i < d->blocks_per_arena; i++) 
         {
           struct block *b = arena_to_block (a, i);
@@ -149,7 +218,15 @@ malloc (size_t size)
   b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
   a = block_to_arena (b);
   a->free_cnt--;
+  idx = block_idx (a, b);
+  arena_tags (a)[idx] = tag;
+  if (palloc_track_sites) 
+    {
+      arena_sites (a)[idx].pc = pc;
+      arena_sites (a)[idx].tid = thread_tid ();
+    }
   lock_release (&d->lock);
+  charge (tag, d->block_size);
   return b;
 }
 
@@ -157,6 +234,15 @@ malloc (size_t size)
    Returns a null pointer if memory is not available. */
 void *
 calloc (size_t a, size_t b) 
+{
+  return calloc_tagged (a, b, MEM_MISC);
+}
+
+/* Allocates and return A times B bytes initialized to zeroes,
+   charged to TAG.
+   Returns a null pointer if memory is not available. */
+void *
+calloc_tagged (size_t a, size_t b, enum mem_tag tag) 
 {
   void *p;
   size_t size;
@@ -167,13 +253,23 @@ calloc (size_t a, size_t b)
     return NULL;
 
   /* Allocate and zero memory. */
-  p = malloc (size);
+  p = tagged_malloc (size, tag, __builtin_return_address (0));
   if (p != NULL)
     memset (p, 0, size);
 
   return p;
 }
 
+/* Returns the tag that BLOCK is charged to. */
+static enum mem_tag
+block_tag (void *block) 
+{
+  struct block *b = block;
+  struct arena *a = block_to_arena (b);
+
+  return a->desc != NULL ? arena_tags (a)[block_idx (a, b)] : a->tag;
+}
+
 /* Returns the number of bytes allocated for BLOCK. */
 static size_t
 block_size (void *block) 
@@ -201,7 +297,9 @@ realloc (void *old_block, size_t new_size)
     }
   else 
     {
-      void *new_block = malloc (new_size);
+      enum mem_tag tag = old_block != NULL ? block_tag (old_block) : MEM_MISC;
+      void *new_block = tagged_malloc (new_size, tag,
+                                       __builtin_return_address (0));
       if (old_block != NULL && new_block != NULL)
         {
           size_t old_size = block_size (old_block);
@@ -227,6 +325,11 @@ free (void *p)
       if (d != NULL) 
         {
           /* It's a normal block.  We handle it here. */
+          size_t idx = block_idx (a, b);
+
+          credit (arena_tags (a)[idx], d->block_size);
+          if (palloc_track_sites)
+            arena_sites (a)[idx].pc = NULL;
 
 #ifndef NDEBUG
           /* Clear the block to help detect use-after-free bugs. */
@@ -249,6 +352,7 @@ free (void *p)
                   struct block *b = arena_to_block (a, i);
                   list_remove (&b->free_elem);
                 }
+              list_remove (&a->elem);
               palloc_free_page (a);
             }
 
@@ -257,6 +361,7 @@ free (void *p)
       else
         {
           /* It's a big block.  Free its pages. */
+          credit (a->tag, a->free_cnt * PGSIZE);
           palloc_free_multiple (a, a->free_cnt);
           return;
         }
@@ -275,7 +380,7 @@ block_to_arena (struct block *b)
 
   /* Check that the block is properly aligned for the arena. */
   ASSERT (a->desc == NULL
-          || (pg_ofs (b) - sizeof *a) % a->desc->block_size == 0);
+          || (pg_ofs (b) - a->desc->blocks_ofs) % a->desc->block_size == 0);
   ASSERT (a->desc != NULL || pg_ofs (b) == sizeof *a);
 
   return a;
@@ -289,6 +394,119 @@ arena_to_block (struct arena *a, size_t idx)
   ASSERT (a->magic == ARENA_MAGIC);
   ASSERT (idx < a->desc->blocks_per_arena);
   return (struct block *) ((uint8_t *) a
-                           + sizeof *a
+                           + a->desc->blocks_ofs
                            + idx * a->desc->block_size);
 }
+
+/* Returns the index of block B within arena A. */
+static size_t
+block_idx (struct arena *a, struct block *b) 
+{
+  ASSERT (a->desc != NULL);
+  return (pg_ofs (b) - a->desc->blocks_ofs) / a->desc->block_size;
+}
+
+/* Returns the array of per-block tags in arena A. */
+static uint8_t *
+arena_tags (struct arena *a) 
+{
+  return (uint8_t *) (a + 1);
+}
+
+/* Returns the array of per-block allocation sites in arena A.
+   Only meaningful if palloc_track_sites is true. */
+static struct alloc_site *
+arena_sites (struct arena *a) 
+{
+  return (struct alloc_site *) ((uint8_t *) a + a->desc->sites_ofs);
+}
+
+/* Charges BYTES to TAG. */
+static void
+charge (enum mem_tag tag, size_t bytes) 
+{
+  enum intr_level old_level = intr_disable ();
+  tag_bytes[tag] += bytes;
+  if (tag_bytes[tag] > tag_peak_bytes[tag])
+    tag_peak_bytes[tag] = tag_bytes[tag];
+  intr_set_level (old_level);
+}
+
+/* Credits BYTES back to TAG. */
+static void
+credit (enum mem_tag tag, size_t bytes) 
+{
+  enum intr_level old_level = intr_disable ();
+  tag_bytes[tag] -= bytes;
+  intr_set_level (old_level);
+}
+
+/* Stores the number of bytes currently charged to TAG into
+   *BYTES and the largest number ever charged to it at once into
+   *PEAK_BYTES. */
+void
+malloc_get_stats (enum mem_tag tag, size_t *bytes, size_t *peak_bytes) 
+{
+  enum intr_level old_level;
+
+  ASSERT (tag < MEM_TAG_CNT);
+
+  old_level = intr_disable ();
+  *bytes = tag_bytes[tag];
+  *peak_bytes = tag_peak_bytes[tag];
+  intr_set_level (old_level);
+}
+
+/* Prints malloc() statistics. */
+void
+malloc_print_stats (void) 
+{
+  enum mem_tag tag;
+
+  printf ("Malloc:");
+  for (tag = 0; tag < MEM_TAG_CNT; tag++) 
+    {
+      size_t bytes, peak_bytes;
+
+      malloc_get_stats (tag, &bytes, &peak_bytes);
+      if (peak_bytes > 0)
+        printf (" %s %zu/%zu", mem_tag_name (tag), bytes, peak_bytes);
+    }
+  printf (" bytes (live/peak)\n");
+}
+
+/* Prints every block allocated by thread TID that is still
+   allocated, with the address that allocated it.  Does nothing
+   unless allocation sites are being tracked. */
+void
+malloc_report_leaks (tid_t tid) 
+{
+  struct desc *d;
+
+  if (!palloc_track_sites)
+    return;
+
+  for (d = descs; d < descs + desc_cnt; d++) 
+    {
+      struct list_elem *e;
+
+      lock_acquire (&d->lock);
+      for (e = list_begin (&d->arenas); e != list_end (&d->arenas);
+           e = list_next (e)) 
+        {
+          struct arena *a = list_entry (e, struct arena, elem);
+          size_t i;
+
+          for (i = 0; i < d->blocks_per_arena; i++) 
+            {
+              struct alloc_site *site = &arena_sites (a)[i];
+              if (site->pc != NULL && site->tid == tid)
+                printf ("leak: %zu-byte block %p (%s) allocated at %p "
+                        "by thread %d\n", d->block_size,
+                        arena_to_block (a, i),
+                        mem_tag_name (arena_tags (a)[i]), site->pc, tid);
+            }
+        }
+      lock_release (&d->lock);
+    }
+}
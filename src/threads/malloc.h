@@ -3,6 +3,7 @@
 
 #include <debug.h>
 #include <stddef.h>
+#include "threads/palloc.h"
 
 void malloc_init (void);
 void *malloc (size_t) __attribute__ ((malloc));
@@ -10,4 +11,10 @@ void *calloc (size_t, size_t) __attribute__ ((malloc));
 void *realloc (void *, size_t);
 void free (void *);
 
+void *malloc_tagged (size_t, enum mem_tag) __attribute__ ((malloc));
+void *calloc_tagged (size_t, size_t, enum mem_tag) __attribute__ ((malloc));
+void malloc_get_stats (enum mem_tag, size_t *bytes, size_t *peak_bytes);
+void malloc_print_stats (void);
+void malloc_report_leaks (tid_t);
+
 #endif /* threads/malloc.h */
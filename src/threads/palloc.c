@@ -7,6 +7,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -23,19 +24,39 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each allocation is charged to a subsystem tag (see enum
+   mem_tag), recorded per page so that freeing a page can credit
+   the same tag without the caller naming it again. */
 
 /* A memory pool. */
 struct pool
   {
     struct lock lock;                   /* Mutual exclusion. */
     struct bitmap *used_map;            /* Bitmap of free pages. */
+    uint8_t *tags;                      /* enum mem_tag of each page. */
+    struct alloc_site *sites;           /* Allocation sites, or null. */
     uint8_t *base;                      /* Base of pool. */
   };
 
 /* Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
+/* Names of the tags in enum mem_tag. */
+static const char *tag_names[MEM_TAG_CNT] = 
+  {
+    "misc", "thread", "pagedir", "malloc", "inode", "file", "vm", "user",
+  };
+
+/* Pages charged to each tag: now, and the most at any one time. */
+static size_t tag_pages[MEM_TAG_CNT];
+static size_t tag_peak_pages[MEM_TAG_CNT];
+
+/* -memtrack: record allocation sites for leak reports? */
+bool palloc_track_sites;
+
+static void *get_multiple (enum palloc_flags, size_t page_cnt, void *pc);
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
@@ -69,16 +90,49 @@ palloc_init (size_t user_page_limit)
    FLAGS, in which case the kernel panics. */
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
+{
+  return get_multiple (flags, page_cnt, __builtin_return_address (0));
+}
+
+/* Like palloc_get_multiple(), but records PC as the allocation
+   site instead of the caller's address.  For allocators, such
+   as malloc(), that get pages on behalf of their own callers. */
+void *
+palloc_get_multiple_at (enum palloc_flags flags, size_t page_cnt, void *pc)
+{
+  return get_multiple (flags, page_cnt, pc);
+}
+
+/* Obtains a single free page and returns its kernel virtual
+   address.
+   If PAL_USER is set, the page is obtained from the user pool,
+   otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
+   then the page is filled with zeros.  If no pages are
+   available, returns a null pointer, unless PAL_ASSERT is set in
+   FLAGS, in which case the kernel panics. */
+void *
+palloc_get_page (enum palloc_flags flags) 
+{
+  return get_multiple (flags, 1, __builtin_return_address (0));
+}
+
+/* Does the work of palloc_get_multiple(), charging the pages to
+   the tag in FLAGS and recording PC as the allocation site. */
+static void *
+get_multiple (enum palloc_flags flags, size_t page_cnt, void *pc)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  enum mem_tag tag = flags & PAL_USER ? MEM_USER : flags >> PAL_TAG_SHIFT;
   void *pages;
   size_t page_idx;
 
+  ASSERT (tag < MEM_TAG_CNT);
+
   if (page_cnt == 0)
     return NULL;
 
   lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+  page_idx = bitmap_scan_and_flip_next (pool->used_map, page_cnt, false);
   lock_release (&pool->lock);
 
   if (page_idx != BITMAP_ERROR)
@@ -88,6 +142,25 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 
   if (pages != NULL) 
     {
+      enum intr_level old_level;
+      size_t i;
+
+      memset (pool->tags + page_idx, tag, page_cnt);
+      if (pool->sites != NULL)
+        for (i = 0; i < page_cnt; i++) 
+          {
+            pool->sites[page_idx + i].pc = pc;
+            pool->sites[page_idx + i].tid = thread_tid ();
+          }
+
+      /* Pages may be freed with interrupts off, so we can't use
+         the pool lock to protect the counters. */
+      old_level = intr_disable ();
+      tag_pages[tag] += page_cnt;
+      if (tag_pages[tag] > tag_peak_pages[tag])
+        tag_peak_pages[tag] = tag_pages[tag];
+      intr_set_level (old_level);
+
       if (flags & PAL_ZERO)
         memset (pages, 0, PGSIZE * page_cnt);
     }
@@ -100,25 +173,13 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
   return pages;
 }
 
-/* Obtains a single free page and returns its kernel virtual
-   address.
-   If PAL_USER is set, the page is obtained from the user pool,
-   otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
-   then the page is filled with zeros.  If no pages are
-   available, returns a null pointer, unless PAL_ASSERT is set in
-   FLAGS, in which case the kernel panics. */
-void *
-palloc_get_page (enum palloc_flags flags) 
-{
-  return palloc_get_multiple (flags, 1);
-}
-
 /* Frees the PAGE_CNT pages starting at PAGES. */
 void
 palloc_free_multiple (void *pages, size_t page_cnt) 
 {
   struct pool *pool;
   size_t page_idx;
+  enum intr_level old_level;
 
   ASSERT (pg_ofs (pages) == 0);
   if (pages == NULL || page_cnt == 0)
@@ -138,6 +199,13 @@ palloc_free_multiple (void *pages, size_t page_cnt)
 #endif
 
   ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
+
+  old_level = intr_disable ();
+  tag_pages[pool->tags[page_idx]] -= page_cnt;
+  intr_set_level (old_level);
+  if (pool->sites != NULL)
+    memset (pool->sites + page_idx, 0, sizeof *pool->sites * page_cnt);
+
   bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
 }
 
@@ -153,10 +221,14 @@ palloc_free_page (void *page)
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
+  /* We'll put the pool's used_map at its base, followed by its
+     per-page tags and allocation sites.
+     Calculate the space needed for them
      and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
+  size_t bm_size = ROUND_UP (bitmap_buf_size (page_cnt), sizeof (void *));
+  size_t tags_size = ROUND_UP (page_cnt, sizeof (void *));
+  size_t sites_size = palloc_track_sites ? page_cnt * sizeof *p->sites : 0;
+  size_t bm_pages = DIV_ROUND_UP (bm_size + tags_size + sites_size, PGSIZE);
   if (bm_pages > page_cnt)
     PANIC ("Not enough memory in %s for bitmap.", name);
   page_cnt -= bm_pages;
@@ -165,7 +237,14 @@ init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
 
   /* Initialize the pool. */
   lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
+  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_size);
+  p->tags = (uint8_t *) base + bm_size;
+  p->sites = NULL;
+  if (palloc_track_sites) 
+    {
+      p->sites = (struct alloc_site *) (p->tags + tags_size);
+      memset (p->sites, 0, sites_size);
+    }
   p->base = base + bm_pages * PGSIZE;
 }
 
@@ -180,3 +259,72 @@ page_from_pool (const struct pool *pool, void *page)
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Returns the name of TAG. */
+const char *
+mem_tag_name (enum mem_tag tag) 
+{
+  ASSERT (tag < MEM_TAG_CNT);
+  return tag_names[tag];
+}
+
+/* Stores the number of pages currently charged to TAG into
+   *PAGES and the largest number ever charged to it at once into
+   *PEAK_PAGES. */
+void
+palloc_get_stats (enum mem_tag tag, size_t *pages, size_t *peak_pages) 
+{
+  enum intr_level old_level;
+
+  ASSERT (tag < MEM_TAG_CNT);
+
+  old_level = intr_disable ();
+  *pages = tag_pages[tag];
+  *peak_pages = tag_peak_pages[tag];
+  intr_set_level (old_level);
+}
+
+/* Prints page allocator statistics. */
+void
+palloc_print_stats (void) 
+{
+  enum mem_tag tag;
+
+  printf ("Pages:");
+  for (tag = 0; tag < MEM_TAG_CNT; tag++) 
+    {
+      size_t pages, peak_pages;
+
+      palloc_get_stats (tag, &pages, &peak_pages);
+      printf (" %s %zu/%zu", tag_names[tag], pages, peak_pages);
+    }
+  printf (" (live/peak)\n");
+}
+
+/* Prints every page allocated by thread TID that is still
+   allocated, with the address that allocated it.  Does nothing
+   unless allocation sites are being tracked.  Thread structures
+   and malloc() arenas are skipped: the former are freed only
+   after a thread finishes dying, and malloc_report_leaks()
+   reports on the blocks within the latter. */
+void
+palloc_report_leaks (tid_t tid) 
+{
+  size_t page_cnt, i;
+
+  if (kernel_pool.sites == NULL)
+    return;
+
+  page_cnt = bitmap_size (kernel_pool.used_map);
+  for (i = 0; i < page_cnt; i++) 
+    {
+      struct alloc_site *site = &kernel_pool.sites[i];
+      enum mem_tag tag = kernel_pool.tags[i];
+
+      if (site->pc != NULL && site->tid == tid
+          && tag != MEM_THREAD && tag != MEM_MALLOC)
+        printf ("leak: page %p (%s) allocated at %p by thread %d\n",
+                kernel_pool.base + i * PGSIZE, tag_names[tag], site->pc,
+                tid);
+    }
+}
@@ -1,7 +1,9 @@
 #ifndef THREADS_PALLOC_H
 #define THREADS_PALLOC_H
 
+#include <stdbool.h>
 #include <stddef.h>
+#include "threads/thread.h"
 
 /* How to allocate pages. */
 enum palloc_flags
@@ -11,10 +13,51 @@ enum palloc_flags
     PAL_USER = 004              /* User page. */
   };
 
+/* Kernel subsystems, for memory accounting.  Every page from
+   palloc and every block from malloc is charged to one of
+   these.  See palloc_print_stats() and malloc_print_stats(). */
+enum mem_tag
+  {
+    MEM_MISC,                   /* Not otherwise classified. */
+    MEM_THREAD,                 /* Thread structures and kernel stacks. */
+    MEM_PAGEDIR,                /* Page directories and page tables. */
+    MEM_MALLOC,                 /* malloc() arenas. */
+    MEM_INODE,                  /* In-memory inodes. */
+    MEM_FILE,                   /* Open files and file buffers. */
+    MEM_VM,                     /* Virtual memory bookkeeping. */
+    MEM_USER,                   /* User pool pages. */
+    MEM_TAG_CNT                 /* Number of tags. */
+  };
+
+/* Charges an allocation to TAG, when ORed into the flags passed
+   to palloc_get_page() or palloc_get_multiple().  Pages without
+   a tag are charged to MEM_MISC, or to MEM_USER if PAL_USER is
+   given. */
+#define PAL_TAG_SHIFT 8
+#define PAL_TAG(TAG) ((TAG) << PAL_TAG_SHIFT)
+
+/* Where and by whom an allocation was made.  Recorded for each
+   allocated page and malloc() block only if palloc_track_sites
+   is true. */
+struct alloc_site
+  {
+    void *pc;                   /* Caller's address, null if free. */
+    tid_t tid;                  /* Allocating thread. */
+  };
+
+/* -memtrack: record allocation sites for leak reports? */
+extern bool palloc_track_sites;
+
 void palloc_init (size_t user_page_limit);
 void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
+void *palloc_get_multiple_at (enum palloc_flags, size_t page_cnt, void *pc);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
 
+const char *mem_tag_name (enum mem_tag);
+void palloc_get_stats (enum mem_tag, size_t *pages, size_t *peak_pages);
+void palloc_print_stats (void);
+void palloc_report_leaks (tid_t);
+
 #endif /* threads/palloc.h */
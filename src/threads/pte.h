@@ -66,6 +66,8 @@ static inline uintptr_t pd_no (const void *va) {
 #define PTE_U 0x4               /* 1=user/kernel, 0=kernel only. */
 #define PTE_A 0x20              /* 1=accessed, 0=not acccessed. */
 #define PTE_D 0x40              /* 1=dirty, 0=not dirty (PTEs only). */
+#define PTE_PS 0x80             /* 1=4 MB page, 0=page table (PDEs only). */
+#define PTE_G 0x100             /* 1=global, kept across CR3 loads. */
 
 /* Returns a PDE that points to page table PT. */
 static inline uint32_t pde_create (uint32_t *pt) {
@@ -80,6 +82,48 @@ static inline uint32_t *pde_get_pt (uint32_t pde) {
   return ptov (pde & PTE_ADDR);
 }
 
+/* Large pages.
+
+   With CR4.PSE set, a PDE with PTE_PS set maps a whole 4 MB
+   (PTSPAN-byte) region directly, without a page table.  Its
+   physical address must be 4 MB-aligned.  Its P, W, U, A, and D
+   bits are in the same positions as in a PTE, so code that only
+   looks at those bits may treat it as a PTE for the region.  See
+   [IA32-v3a] 3.7.3 "Mixing 4-KByte and 4-MByte Pages". */
+
+/* Returns true if PDE is present and maps a large page. */
+static inline bool pde_is_large (uint32_t pde) {
+  return (pde & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS);
+}
+
+/* Returns a PDE that maps the 4 MB region starting at PAGE as a
+   single large page.
+   If WRITABLE is true then it will be writable as well.
+   The page will be usable only by ring 0 code (the kernel). */
+static inline uint32_t pde_create_kernel_large (void *page, bool writable) {
+  ASSERT (vtop (page) % PTSPAN == 0);
+  return vtop (page) | PTE_P | PTE_PS | (writable ? PTE_W : 0);
+}
+
+/* Returns a PDE that maps the 4 MB region starting at PAGE as a
+   single large page that user programs may use.
+   If WRITABLE is true then it will be writable as well. */
+static inline uint32_t pde_create_user_large (void *page, bool writable) {
+  return pde_create_kernel_large (page, writable) | PTE_U;
+}
+
+/* Returns a pointer to the start of the 4 MB region that the
+   large-page PDE maps. */
+static inline void *pde_get_large_page (uint32_t pde) {
+  ASSERT (pde_is_large (pde));
+  return ptov (pde & ~(PTSPAN - 1));
+}
+
+/* Returns the offset of VA within its 4 MB large page. */
+static inline unsigned large_pg_ofs (const void *va) {
+  return (uintptr_t) va & (PTSPAN - 1);
+}
+
 /* Returns a PTE that points to PAGE.
    The PTE's page is readable.
    If WRITABLE is true then it will be writable as well.
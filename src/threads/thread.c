@@ -181,7 +181,7 @@ thread_create (const char *name, int priority,
   ASSERT (function != NULL);
 
   /* Allocate thread. */
-  t = palloc_get_page (PAL_ZERO);
+  t = palloc_get_page (PAL_ZERO | PAL_TAG (MEM_THREAD));
   if (t == NULL)
     return TID_ERROR;
 
@@ -535,6 +535,12 @@ init_thread (struct thread *t, const char *name, int priority)
   list_init(&t->donors); //This is thread safe. No other thread will see or modify inconsistent data.
   t->nice = 0;
   t->recent_cpu = 0;
+#ifdef USERPROG
+  list_init (&t->fds);
+  t->next_handle = 2;
+  list_init (&t->mappings);
+  t->next_mapid = 0;
+#endif
   old_level = intr_disable ();
   list_push_back (&all_list, &t->allelem);
   intr_set_level (old_level);
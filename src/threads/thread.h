@@ -105,6 +105,30 @@ struct thread
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
+
+    /* Owned by userprog/syscall.c. */
+    struct list fds;                    /* List of file descriptors. */
+    int next_handle;                    /* Next handle value. */
+    struct list mappings;               /* Memory-mapped files. */
+    int next_mapid;                     /* Next memory mapping id. */
+#endif
+#ifdef VM
+    /* Owned by vm/page.c. */
+    struct hash *pages;                 /* Supplemental page table. */
+    void *fault_next;                   /* Page after last fault-around. */
+    size_t fault_window;                /* Read-ahead window, in pages. */
+    void *user_esp;                     /* User esp on entry to kernel. */
+    struct list large_regions;          /* Regions mapped by large pages. */
+
+    /* Owned by vm/frame.c. */
+    size_t rss;                         /* Pages resident now. */
+    size_t peak_rss;                    /* Most pages resident at once. */
+    size_t rss_limit;                   /* Preferred most resident, or 0. */
+    size_t wss;                         /* Working set estimate, in pages. */
+    size_t wss_next;                    /* Working set counted this sweep. */
+
+    /* Owned by userprog/process.c. */
+    struct file *exec_file;             /* Executable, for paging in. */
 #endif
 
     /* Owned by thread.c. */
@@ -7,7 +7,8 @@
 #include "threads/palloc.h"
 
 static uint32_t *active_pd (void);
-static void invalidate_pagedir (uint32_t *);
+static void invalidate_page (uint32_t *, const void *vaddr,
+                             struct tlb_batch *);
 
 /* Creates a new page directory that has mappings for kernel
    virtual addresses, but none for user virtual addresses.
@@ -16,7 +17,7 @@ static void invalidate_pagedir (uint32_t *);
 uint32_t *
 pagedir_create (void) 
 {
-  uint32_t *pd = palloc_get_page (0);
+  uint32_t *pd = palloc_get_page (PAL_TAG (MEM_PAGEDIR));
   if (pd != NULL)
     memcpy (pd, init_page_dir, PGSIZE);
   return pd;
@@ -34,7 +35,7 @@ pagedir_destroy (uint32_t *pd)
 
   ASSERT (pd != init_page_dir);
   for (pde = pd; pde < pd + pd_no (PHYS_BASE); pde++)
-    if (*pde & PTE_P) 
+    if ((*pde & PTE_P) && !pde_is_large (*pde)) 
       {
         uint32_t *pt = pde_get_pt (*pde);
         uint32_t *pte;
@@ -52,7 +53,10 @@ pagedir_destroy (uint32_t *pd)
    If PD does not have a page table for VADDR, behavior depends
    on CREATE.  If CREATE is true, then a new page table is
    created and a pointer into it is returned.  Otherwise, a null
-   pointer is returned. */
+   pointer is returned.
+   If VADDR lies in a large page, returns the large page's PDE,
+   whose accessed, dirty, and present bits are laid out like a
+   PTE's. */
 static uint32_t *
 lookup_page (uint32_t *pd, const void *vaddr, bool create)
 {
@@ -70,7 +74,7 @@ lookup_page (uint32_t *pd, const void *vaddr, bool create)
     {
       if (create)
         {
-          pt = palloc_get_page (PAL_ZERO);
+          pt = palloc_get_page (PAL_ZERO | PAL_TAG (MEM_PAGEDIR));
           if (pt == NULL) 
             return NULL; 
       
@@ -80,6 +84,13 @@ lookup_page (uint32_t *pd, const void *vaddr, bool create)
         return NULL;
     }
 
+  /* A large page has no page table. */
+  if (pde_is_large (*pde)) 
+    {
+      ASSERT (!create);
+      return pde;
+    }
+
   /* Return the page table entry. */
   pt = pde_get_pt (*pde);
   return &pt[pt_no (vaddr)];
@@ -118,6 +129,67 @@ pagedir_set_page (uint32_t *pd, void *upage, void *kpage, bool writable)
     return false;
 }
 
+/* Maps the 4 MB region at user virtual address UPAGE, which
+   must be 4 MB-aligned, in page directory PD to the physically
+   contiguous region at kernel virtual address KPAGE, which must
+   be 4 MB-aligned too, with a single large page.  If WRITABLE is
+   true, the region is read/write; otherwise it is read-only.
+   No page in the region may be mapped.  Requires CR4.PSE. */
+void
+pagedir_set_large_page (uint32_t *pd, void *upage, void *kpage,
+                        bool writable) 
+{
+  uint32_t *pde = pd + pd_no (upage);
+
+  ASSERT (large_pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr ((uint8_t *) upage + PTSPAN - 1));
+  ASSERT (pd != init_page_dir);
+
+  /* Free the region's page table, left behind by earlier
+     mappings. */
+  if (*pde != 0) 
+    {
+      uint32_t *pt = pde_get_pt (*pde);
+      uint32_t *pte;
+
+      for (pte = pt; pte < pt + PGSIZE / sizeof *pte; pte++)
+        ASSERT ((*pte & PTE_P) == 0);
+      palloc_free_page (pt);
+    }
+  *pde = pde_create_user_large (kpage, writable);
+
+  /* The CPU may still cache the old directory entry, which
+     points to the page table we just freed.  Reloading CR3
+     flushes it, along with any TLB entry for the region, at
+     less cost than an INVLPG for each of its 1,024 pages. */
+  if (active_pd () == pd)
+    pagedir_activate (pd);
+}
+
+/* Replaces the large page that maps the 4 MB region containing
+   UPAGE in page directory PD by page table PT, filled with
+   entries that map each page of the region to the same memory,
+   with the large page's permissions and its accessed and dirty
+   bits. */
+void
+pagedir_split_large_page (uint32_t *pd, const void *upage, uint32_t *pt) 
+{
+  uint32_t *pde = pd + pd_no (upage);
+  uint8_t *kpage;
+  uint32_t bits;
+  size_t i;
+
+  ASSERT (pde_is_large (*pde));
+  ASSERT (pg_ofs (pt) == 0);
+
+  kpage = pde_get_large_page (*pde);
+  bits = *pde & (PTE_A | PTE_D);
+  for (i = 0; i < PGSIZE / sizeof *pt; i++)
+    pt[i] = pte_create_user (kpage + i * PGSIZE, *pde & PTE_W) | bits;
+  *pde = pde_create (pt);
+  invalidate_page (pd, upage, NULL);
+}
+
 /* Looks up the physical address that corresponds to user virtual
    address UADDR in PD.  Returns the kernel virtual address
    corresponding to that physical address, or a null pointer if
@@ -129,6 +201,9 @@ pagedir_get_page (uint32_t *pd, const void *uaddr)
 
   ASSERT (is_user_vaddr (uaddr));
   
+  if (pde_is_large (pd[pd_no (uaddr)]))
+    return pde_get_large_page (pd[pd_no (uaddr)]) + large_pg_ofs (uaddr);
+
   pte = lookup_page (pd, uaddr, false);
   if (pte != NULL && (*pte & PTE_P) != 0)
     return pte_get_page (*pte) + pg_ofs (uaddr);
@@ -142,6 +217,17 @@ pagedir_get_page (uint32_t *pd, const void *uaddr)
    UPAGE need not be mapped. */
 void
 pagedir_clear_page (uint32_t *pd, void *upage) 
+{
+  pagedir_clear_page_batch (pd, upage, NULL);
+}
+
+/* Like pagedir_clear_page(), but if BATCH is nonnull, only
+   records UPAGE in BATCH instead of invalidating its TLB entry.
+   The caller must call pagedir_flush() before PD's process can
+   run in user mode again. */
+void
+pagedir_clear_page_batch (uint32_t *pd, void *upage,
+                          struct tlb_batch *batch) 
 {
   uint32_t *pte;
 
@@ -152,7 +238,35 @@ pagedir_clear_page (uint32_t *pd, void *upage)
   if (pte != NULL && (*pte & PTE_P) != 0)
     {
       *pte &= ~PTE_P;
-      invalidate_pagedir (pd);
+      invalidate_page (pd, upage, batch);
+    }
+}
+
+/* Returns true if the PTE for virtual page VPAGE in PD is
+   present and writable.
+   Returns false if PD contains no PTE for VPAGE. */
+bool
+pagedir_is_writable (uint32_t *pd, const void *vpage) 
+{
+  uint32_t *pte = lookup_page (pd, vpage, false);
+  return pte != NULL && (*pte & (PTE_P | PTE_W)) == (PTE_P | PTE_W);
+}
+
+/* Sets the writable bit to WRITABLE in the PTE for virtual page
+   VPAGE in PD. */
+void
+pagedir_set_writable (uint32_t *pd, const void *vpage, bool writable) 
+{
+  uint32_t *pte = lookup_page (pd, vpage, false);
+  if (pte != NULL) 
+    {
+      if (writable)
+        *pte |= PTE_W;
+      else 
+        {
+          *pte &= ~(uint32_t) PTE_W;
+          invalidate_page (pd, vpage, NULL);
+        }
     }
 }
 
@@ -180,7 +294,7 @@ pagedir_set_dirty (uint32_t *pd, const void *vpage, bool dirty)
       else 
         {
           *pte &= ~(uint32_t) PTE_D;
-          invalidate_pagedir (pd);
+          invalidate_page (pd, vpage, NULL);
         }
     }
 }
@@ -209,7 +323,7 @@ pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed)
       else 
         {
           *pte &= ~(uint32_t) PTE_A; 
-          invalidate_pagedir (pd);
+          invalidate_page (pd, vpage, NULL);
         }
     }
 }
@@ -243,21 +357,50 @@ active_pd (void)
   return ptov (pd);
 }
 
-/* Seom page table changes can cause the CPU's translation
+/* Initializes BATCH as an empty batch of TLB invalidations. */
+void
+pagedir_batch_init (struct tlb_batch *batch) 
+{
+  batch->cnt = 0;
+}
+
+/* Invalidates the TLB entries recorded in BATCH, and empties it.
+   A batch that overflowed flushes the whole TLB, except for the
+   kernel's global mappings. */
+void
+pagedir_flush (struct tlb_batch *batch) 
+{
+  if (batch->cnt > TLB_BATCH_SIZE)
+    pagedir_activate (active_pd ());
+  else 
+    {
+      size_t i;
+      for (i = 0; i < batch->cnt; i++)
+        asm volatile ("invlpg (%0)" : : "r" (batch->pages[i]) : "memory");
+    }
+  batch->cnt = 0;
+}
+
+/* Some page table changes can cause the CPU's translation
    lookaside buffer (TLB) to become out-of-sync with the page
-   table.  When this happens, we have to "invalidate" the TLB by
-   re-activating it.
+   table.  When this happens, we have to "invalidate" the TLB
+   entry for the page that changed, with the INVLPG instruction.
+   If BATCH is nonnull, the page is recorded in it to be
+   invalidated later by pagedir_flush() instead.
 
-   This function invalidates the TLB if PD is the active page
-   directory.  (If PD is not active then its entries are not in
-   the TLB, so there is no need to invalidate anything.) */
+   Nothing is done if PD is not the active page directory, since
+   then its entries are not in the TLB.  (The kernel's own
+   mappings are global, so loading CR3 does not flush them, but
+   they never change.)  See [IA32-v3a] 3.12 "Translation
+   Lookaside Buffers (TLBs)". */
 static void
-invalidate_pagedir (uint32_t *pd) 
+invalidate_page (uint32_t *pd, const void *vaddr, struct tlb_batch *batch) 
 {
-  if (active_pd () == pd) 
-    {
-      /* Re-activating PD clears the TLB.  See [IA32-v3a] 3.12
-         "Translation Lookaside Buffers (TLBs)". */
-      pagedir_activate (pd);
-    } 
+  if (active_pd () != pd)
+    return;
+
+  if (batch == NULL)
+    asm volatile ("invlpg (%0)" : : "r" (vaddr) : "memory");
+  else if (batch->cnt++ < TLB_BATCH_SIZE)
+    batch->pages[batch->cnt - 1] = vaddr;
 }
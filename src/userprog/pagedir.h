@@ -2,17 +2,40 @@
 #define USERPROG_PAGEDIR_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+/* Most TLB entries a batch records individually.  A batch with
+   more flushes the whole TLB instead. */
+#define TLB_BATCH_SIZE 16
+
+/* A batch of deferred TLB invalidations, for changing many page
+   table entries and then flushing them all at once. */
+struct tlb_batch 
+  {
+    size_t cnt;                         /* Number of pages changed. */
+    const void *pages[TLB_BATCH_SIZE];  /* Pages changed. */
+  };
+
 uint32_t *pagedir_create (void);
 void pagedir_destroy (uint32_t *pd);
 bool pagedir_set_page (uint32_t *pd, void *upage, void *kpage, bool rw);
 void *pagedir_get_page (uint32_t *pd, const void *upage);
+void pagedir_set_large_page (uint32_t *pd, void *upage, void *kpage,
+                             bool writable);
+void pagedir_split_large_page (uint32_t *pd, const void *upage,
+                               uint32_t *pt);
 void pagedir_clear_page (uint32_t *pd, void *upage);
+void pagedir_clear_page_batch (uint32_t *pd, void *upage,
+                               struct tlb_batch *);
+bool pagedir_is_writable (uint32_t *pd, const void *upage);
+void pagedir_set_writable (uint32_t *pd, const void *upage, bool writable);
 bool pagedir_is_dirty (uint32_t *pd, const void *upage);
 void pagedir_set_dirty (uint32_t *pd, const void *upage, bool dirty);
 bool pagedir_is_accessed (uint32_t *pd, const void *upage);
 void pagedir_set_accessed (uint32_t *pd, const void *upage, bool accessed);
 void pagedir_activate (uint32_t *pd);
+void pagedir_batch_init (struct tlb_batch *);
+void pagedir_flush (struct tlb_batch *);
 
 #endif /* userprog/pagedir.h */
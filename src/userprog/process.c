@@ -11,15 +11,26 @@
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/inode.h"
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "userprog/syscall.h"
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#endif
 
 static thread_func start_process NO_RETURN;
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
+#ifdef VM
+static thread_func start_fork NO_RETURN;
+#endif
 
 /* Starts a new thread running a user program loaded from
    FILENAME.  The new thread may be scheduled (and may even exit)
@@ -76,6 +87,76 @@ start_process (void *file_name_)
   NOT_REACHED ();
 }
 
+#ifdef VM
+/* Passed from process_fork() to start_fork(). */
+struct fork_info 
+  {
+    struct thread *parent;      /* Forking thread. */
+    struct intr_frame if_;      /* Parent's user context. */
+    struct semaphore done;      /* Upped when the child is set up. */
+    bool success;               /* Was the child set up? */
+  };
+
+/* Creates a new process that is a copy of the current one,
+   whose user context is IF_.  The child returns 0 from the
+   system call in the same place.  Its pages are shared with the
+   parent copy-on-write rather than copied.  Returns the child's
+   thread id, or TID_ERROR if the child could not be created. */
+tid_t
+process_fork (const struct intr_frame *if_) 
+{
+  struct fork_info info;
+  tid_t tid;
+
+  info.parent = thread_current ();
+  info.if_ = *if_;
+  sema_init (&info.done, 0);
+
+  tid = thread_create (info.parent->name, PRI_DEFAULT, start_fork, &info);
+  if (tid == TID_ERROR)
+    return TID_ERROR;
+  sema_down (&info.done);
+  return info.success ? tid : TID_ERROR;
+}
+
+/* A thread function that sets up a process forked by
+   process_fork() and starts it running. */
+static void
+start_fork (void *info_) 
+{
+  struct fork_info *info = info_;
+  struct thread *parent = info->parent;
+  struct thread *t = thread_current ();
+  struct intr_frame if_ = info->if_;
+  bool success = false;
+
+  t->pagedir = pagedir_create ();
+  if (t->pagedir != NULL) 
+    {
+      process_activate ();
+      lock_acquire (&filesys_lock);
+      t->exec_file = file_reopen (parent->exec_file);
+      lock_release (&filesys_lock);
+      success = (t->exec_file != NULL
+                 && page_table_create ()
+                 && page_table_copy (parent)
+                 && syscall_fork (parent));
+    }
+
+  /* INFO is on the parent's stack, so it must not be touched
+     once the parent is released. */
+  info->success = success;
+  sema_up (&info->done);
+  if (!success)
+    thread_exit ();
+
+  /* Return 0 from fork() in the child. */
+  if_.eax = 0;
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+#endif /* VM */
+
 /* Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
    exception), returns -1.  If TID is invalid or if it was not a
@@ -98,6 +179,21 @@ process_exit (void)
   struct thread *cur = thread_current ();
   uint32_t *pd;
 
+  /* Write back and remove memory mappings, and close files. */
+  syscall_exit ();
+
+#ifdef VM
+  /* With -rss, report the process's memory use.  Then release
+     its frames, which belong to the frame table, before
+     pagedir_destroy() can free them. */
+  frame_print_usage ();
+  page_table_destroy ();
+  lock_acquire (&filesys_lock);
+  file_close (cur->exec_file);
+  lock_release (&filesys_lock);
+  cur->exec_file = NULL;
+#endif
+
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
   pd = cur->pagedir;
@@ -114,6 +210,10 @@ process_exit (void)
       pagedir_activate (NULL);
       pagedir_destroy (pd);
     }
+
+  /* With -memtrack, report kernel memory the process left behind. */
+  palloc_report_leaks (cur->tid);
+  malloc_report_leaks (cur->tid);
 }
 
 /* Sets up the CPU for running user code in the current
@@ -201,33 +301,118 @@ static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
                           uint32_t read_bytes, uint32_t zero_bytes,
                           bool writable);
 
-/* Loads an ELF executable from FILE_NAME into the current thread.
-   Stores the executable's entry point into *EIP
-   and its initial stack pointer into *ESP.
-   Returns true if successful, false otherwise. */
-bool
-load (const char *file_name, void (**eip) (void), void **esp) 
-{
-  struct thread *t = thread_current ();
-  struct Elf32_Ehdr ehdr;
-  struct file *file = NULL;
-  off_t file_ofs;
-  bool success = false;
-  int i;
+/* Cache of parsed executables.
+
+   Running a program means reading and checking its ELF header
+   and every program header before the first instruction runs.
+   The same few programs tend to be run over and over, so load()
+   remembers the result of that work for the last few
+   executables, keyed by inode and checked against the inode's
+   version, which changes whenever the file is written.  Each
+   entry keeps its inode open, so that the version survives the
+   last process running the executable exiting and the next one
+   starting, and so that the inode's sector can't be reused by a
+   new file while it is cached.
+   A cached executable is loaded from its list of segments
+   without reading the file at all; with VM, its pages are then
+   read in as they are touched, or at once for small segments
+   (see page_populate()). */
+
+/* A loadable segment, as passed to load_segment(). */
+struct exec_segment
+  {
+    uint32_t file_page;         /* Page-aligned offset in file. */
+    uint32_t mem_page;          /* Page-aligned user address. */
+    uint32_t read_bytes;        /* Bytes to read from file. */
+    uint32_t zero_bytes;        /* Bytes to zero after them. */
+    bool writable;              /* Writable by the process? */
+  };
 
-  /* Allocate and activate page directory. */
-  t->pagedir = pagedir_create ();
-  if (t->pagedir == NULL) 
-    goto done;
-  process_activate ();
+/* Most loadable segments in a cached executable.  Executables
+   with more are loaded normally but not cached. */
+#define EXEC_MAX_SEGMENTS 8
 
-  /* Open executable file. */
-  file = filesys_open (file_name);
-  if (file == NULL) 
+/* A parsed executable. */
+struct exec_info
+  {
+    bool valid;                 /* Holds a parsed executable? */
+    struct inode *inode;        /* Executable's inode, kept open. */
+    unsigned version;           /* Inode version when parsed. */
+    Elf32_Addr entry;           /* Entry point. */
+    size_t segment_cnt;         /* Number of loadable segments. */
+    struct exec_segment segments[EXEC_MAX_SEGMENTS];
+  };
+
+/* Number of cached executables. */
+#define EXEC_CACHE_CNT 8
+
+/* Cached executables, protected by FILESYS_LOCK. */
+static struct exec_info exec_cache[EXEC_CACHE_CNT];
+static size_t exec_cache_next;  /* Next entry to replace. */
+
+/* Statistics. */
+static long long load_cnt;      /* Executables loaded. */
+static long long exec_hit_cnt;  /* Loaded from the cache. */
+
+/* Prints executable loading statistics. */
+void
+process_print_stats (void) 
+{
+  printf ("Exec: %lld loads, %lld from header cache\n",
+          load_cnt, exec_hit_cnt);
+}
+
+/* Returns the cache entry for FILE's inode, if it is current.
+   Otherwise, claims an entry for FILE, marks it invalid, and
+   sets *HIT to false.  The entry claimed is the one that already
+   holds FILE's inode, if any, since it is out of date; otherwise
+   it is the next one in turn.  FILESYS_LOCK must be held. */
+static struct exec_info *
+exec_cache_lookup (struct file *file, bool *hit) 
+{
+  struct inode *inode = file_get_inode (file);
+  struct exec_info *e = NULL;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&filesys_lock));
+
+  for (i = 0; i < EXEC_CACHE_CNT; i++) 
+    if (exec_cache[i].inode == inode) 
+      {
+        e = &exec_cache[i];
+        if (e->valid && e->version == inode_get_version (inode)) 
+          {
+            *hit = true;
+            return e;
+          }
+        break;
+      }
+
+  if (e == NULL) 
     {
-      printf ("load: %s: open failed\n", file_name);
-      goto done; 
+      e = &exec_cache[exec_cache_next];
+      exec_cache_next = (exec_cache_next + 1) % EXEC_CACHE_CNT;
+      inode_close (e->inode);
+      e->inode = inode_reopen (inode);
     }
+  e->valid = false;
+  e->version = inode_get_version (inode);
+  e->segment_cnt = 0;
+  *hit = false;
+  return e;
+}
+
+/* Reads and checks the ELF header and program headers of FILE,
+   named FILE_NAME, and loads its segments, recording the
+   entry point and the segments in E.  Returns true if
+   successful, false otherwise.  FILESYS_LOCK must be held. */
+static bool
+parse_exec (const char *file_name, struct file *file, struct exec_info *e) 
+{
+  struct Elf32_Ehdr ehdr;
+  bool cacheable = true;
+  off_t file_ofs;
+  int i;
 
   /* Read and verify executable header. */
   if (file_read (file, &ehdr, sizeof ehdr) != sizeof ehdr
@@ -239,8 +424,9 @@ load (const char *file_name, void (**eip) (void), void **esp)
       || ehdr.e_phnum > 1024) 
     {
       printf ("load: %s: error loading executable\n", file_name);
-      goto done; 
+      return false;
     }
+  e->entry = ehdr.e_entry;
 
   /* Read program headers. */
   file_ofs = ehdr.e_phoff;
@@ -249,11 +435,11 @@ load (const char *file_name, void (**eip) (void), void **esp)
       struct Elf32_Phdr phdr;
 
       if (file_ofs < 0 || file_ofs > file_length (file))
-        goto done;
+        return false;
       file_seek (file, file_ofs);
 
       if (file_read (file, &phdr, sizeof phdr) != sizeof phdr)
-        goto done;
+        return false;
       file_ofs += sizeof phdr;
       switch (phdr.p_type) 
         {
@@ -267,58 +453,151 @@ load (const char *file_name, void (**eip) (void), void **esp)
         case PT_DYNAMIC:
         case PT_INTERP:
         case PT_SHLIB:
-          goto done;
+          return false;
         case PT_LOAD:
           if (validate_segment (&phdr, file)) 
             {
-              bool writable = (phdr.p_flags & PF_W) != 0;
-              uint32_t file_page = phdr.p_offset & ~PGMASK;
-              uint32_t mem_page = phdr.p_vaddr & ~PGMASK;
+              struct exec_segment seg;
               uint32_t page_offset = phdr.p_vaddr & PGMASK;
-              uint32_t read_bytes, zero_bytes;
+
+              seg.writable = (phdr.p_flags & PF_W) != 0;
+              seg.file_page = phdr.p_offset & ~PGMASK;
+              seg.mem_page = phdr.p_vaddr & ~PGMASK;
               if (phdr.p_filesz > 0)
                 {
                   /* Normal segment.
                      Read initial part from disk and zero the rest. */
-                  read_bytes = page_offset + phdr.p_filesz;
-                  zero_bytes = (ROUND_UP (page_offset + phdr.p_memsz, PGSIZE)
-                                - read_bytes);
+                  seg.read_bytes = page_offset + phdr.p_filesz;
+                  seg.zero_bytes = (ROUND_UP (page_offset + phdr.p_memsz,
+                                              PGSIZE)
+                                    - seg.read_bytes);
                 }
               else 
                 {
                   /* Entirely zero.
                      Don't read anything from disk. */
-                  read_bytes = 0;
-                  zero_bytes = ROUND_UP (page_offset + phdr.p_memsz, PGSIZE);
+                  seg.read_bytes = 0;
+                  seg.zero_bytes = ROUND_UP (page_offset + phdr.p_memsz,
+                                             PGSIZE);
                 }
-              if (!load_segment (file, file_page, (void *) mem_page,
-                                 read_bytes, zero_bytes, writable))
-                goto done;
+              if (!load_segment (file, seg.file_page, (void *) seg.mem_page,
+                                 seg.read_bytes, seg.zero_bytes,
+                                 seg.writable))
+                return false;
+              if (e->segment_cnt < EXEC_MAX_SEGMENTS)
+                e->segments[e->segment_cnt++] = seg;
+              else
+                cacheable = false;
             }
           else
-            goto done;
+            return false;
           break;
         }
     }
 
+  e->valid = cacheable;
+  return true;
+}
+
+/* Loads an ELF executable from FILE_NAME into the current thread.
+   Stores the executable's entry point into *EIP
+   and its initial stack pointer into *ESP.
+   Returns true if successful, false otherwise. */
+bool
+load (const char *file_name, void (**eip) (void), void **esp) 
+{
+  struct thread *t = thread_current ();
+  struct exec_info *e;
+  struct file *file = NULL;
+  Elf32_Addr entry;
+#ifdef VM
+  struct exec_segment segments[EXEC_MAX_SEGMENTS];
+  size_t segment_cnt;
+#endif
+  bool success = false;
+  bool hit;
+  size_t i;
+
+  /* Allocate and activate page directory. */
+  t->pagedir = pagedir_create ();
+  if (t->pagedir == NULL) 
+    goto done;
+  process_activate ();
+#ifdef VM
+  if (!page_table_create ())
+    goto done;
+#endif
+
+  /* Open executable file. */
+  lock_acquire (&filesys_lock);
+  file = filesys_open (file_name);
+  if (file == NULL) 
+    {
+      printf ("load: %s: open failed\n", file_name);
+      goto done; 
+    }
+#ifdef VM
+  /* Segments are read in as they are touched, so the file must
+     stay open until the process exits. */
+  t->exec_file = file;
+#endif
+
+  /* Load the segments the cache remembers, or parse the file. */
+  load_cnt++;
+  e = exec_cache_lookup (file, &hit);
+  if (hit) 
+    {
+      exec_hit_cnt++;
+      for (i = 0; i < e->segment_cnt; i++) 
+        {
+          const struct exec_segment *seg = &e->segments[i];
+          if (!load_segment (file, seg->file_page, (void *) seg->mem_page,
+                             seg->read_bytes, seg->zero_bytes, seg->writable))
+            goto done;
+        }
+    }
+  else if (!parse_exec (file_name, file, e))
+    goto done;
+  entry = e->entry;
+#ifdef VM
+  segment_cnt = e->segment_cnt;
+  memcpy (segments, e->segments, segment_cnt * sizeof *segments);
+#endif
+
   /* Set up stack. */
+  lock_release (&filesys_lock);
   if (!setup_stack (esp))
     goto done;
 
+#ifdef VM
+  /* Read in the segments that are small enough that faulting
+     them in a page at a time would cost more. */
+  for (i = 0; i < segment_cnt; i++)
+    page_populate ((void *) segments[i].mem_page,
+                   segments[i].read_bytes + segments[i].zero_bytes);
+#endif
+
   /* Start address. */
-  *eip = (void (*) (void)) ehdr.e_entry;
+  *eip = (void (*) (void)) entry;
 
   success = true;
 
  done:
   /* We arrive here whether the load is successful or not. */
+  if (!lock_held_by_current_thread (&filesys_lock))
+    lock_acquire (&filesys_lock);
+#ifndef VM
   file_close (file);
+#endif
+  lock_release (&filesys_lock);
   return success;
 }
 
 /* load() helpers. */
 
+#ifndef VM
 static bool install_page (void *upage, void *kpage, bool writable);
+#endif
 
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
@@ -377,6 +656,11 @@ validate_segment (const struct Elf32_Phdr *phdr, struct file *file)
    The pages initialized by this function must be writable by the
    user process if WRITABLE is true, read-only otherwise.
 
+   With VM, the pages are only entered in the supplemental page
+   table, to be read in by page_in() when they are first touched.
+   Read-only pages of file data are shared through the page
+   cache.
+
    Return true if successful, false if a memory allocation error
    or disk read error occurs. */
 static bool
@@ -396,6 +680,22 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
+#ifdef VM
+      /* Describe this page so that it can be loaded on demand.
+         A read-only page that holds nothing but file data, with
+         zeros only past the end of the file, is the same in
+         every process that runs FILE, so it maps the file's page
+         in the page cache and all of them share one frame. */
+      bool shared = (!writable && page_read_bytes > 0
+                     && (page_read_bytes == PGSIZE
+                         || ofs + (off_t) page_read_bytes
+                            == file_length (file)));
+      if (shared
+          ? !page_add_shared (upage, file, ofs, false)
+          : !page_add_file (upage, file, ofs, page_read_bytes, writable))
+        return false;
+      ofs += page_read_bytes;
+#else
       /* Get a page of memory. */
       uint8_t *kpage = palloc_get_page (PAL_USER);
       if (kpage == NULL)
@@ -415,6 +715,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
           palloc_free_page (kpage);
           return false; 
         }
+#endif
 
       /* Advance. */
       read_bytes -= page_read_bytes;
@@ -425,10 +726,17 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 }
 
 /* Create a minimal stack by mapping a zeroed page at the top of
-   user virtual memory. */
+   user virtual memory.  With VM, the page is zeroed and mapped
+   when the process first pushes onto it. */
 static bool
 setup_stack (void **esp) 
 {
+#ifdef VM
+  if (!page_add_zero (((uint8_t *) PHYS_BASE) - PGSIZE, true))
+    return false;
+  *esp = PHYS_BASE;
+  return true;
+#else
   uint8_t *kpage;
   bool success = false;
 
@@ -442,8 +750,10 @@ setup_stack (void **esp)
         palloc_free_page (kpage);
     }
   return success;
+#endif
 }
 
+#ifndef VM
 /* Adds a mapping from user virtual address UPAGE to kernel
    virtual address KPAGE to the page table.
    If WRITABLE is true, the user process may modify the page;
@@ -463,3 +773,4 @@ install_page (void *upage, void *kpage, bool writable)
   return (pagedir_get_page (t->pagedir, upage) == NULL
           && pagedir_set_page (t->pagedir, upage, kpage, writable));
 }
+#endif
@@ -1,10 +1,118 @@
 #include "userprog/syscall.h"
+#include <memstat.h>
+#include <ring.h>
+#include <round.h>
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
+#include "devices/input.h"
+#include "devices/shutdown.h"
+#include "filesys/file.h"
+#include "filesys/filesys.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/pte.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#ifdef VM
+#include "vm/cache.h"
+#include "vm/frame.h"
+#include "vm/page.h"
+#endif
+
+/* A system call handler.  ARGS holds the call's arguments,
+   already copied in from the user stack.  Returns the value to
+   put in the caller's EAX. */
+typedef uint32_t syscall_function (const uint32_t args[]);
+
+/* A system call. */
+struct syscall 
+  {
+    syscall_function *func;     /* Handler, or null if unimplemented. */
+    size_t arg_cnt;             /* Number of arguments. */
+    bool ringable;              /* May be queued on a ring? */
+  };
+
+/* Most arguments that any system call takes. */
+#define SYSCALL_MAX_ARGS 3
+
+static syscall_function sys_halt, sys_exit, sys_create, sys_remove;
+static syscall_function sys_open, sys_filesize, sys_read, sys_write;
+static syscall_function sys_seek, sys_tell, sys_close, sys_memstat;
+static syscall_function sys_ring_enter;
+#ifdef VM
+static syscall_function sys_mmap, sys_munmap, sys_fork;
+static syscall_function sys_vmstat, sys_rsslimit, sys_mmap_anon;
+#endif
+
+/* Table of system calls, indexed by number. */
+static const struct syscall syscalls[] = 
+  {
+    [SYS_HALT] = {sys_halt, 0},
+    [SYS_EXIT] = {sys_exit, 1},
+    [SYS_CREATE] = {sys_create, 2, true},
+    [SYS_REMOVE] = {sys_remove, 1, true},
+    [SYS_OPEN] = {sys_open, 1, true},
+    [SYS_FILESIZE] = {sys_filesize, 1, true},
+    [SYS_READ] = {sys_read, 3, true},
+    [SYS_WRITE] = {sys_write, 3, true},
+    [SYS_SEEK] = {sys_seek, 2, true},
+    [SYS_TELL] = {sys_tell, 1, true},
+    [SYS_CLOSE] = {sys_close, 1, true},
+#ifdef VM
+    [SYS_MMAP] = {sys_mmap, 2},
+    [SYS_MUNMAP] = {sys_munmap, 1},
+#endif
+    [SYS_MEMSTAT] = {sys_memstat, 2},
+#ifdef VM
+    [SYS_FORK] = {sys_fork, 0},
+    [SYS_VMSTAT] = {sys_vmstat, 1},
+    [SYS_RSSLIMIT] = {sys_rsslimit, 1},
+    [SYS_MMAP_ANON] = {sys_mmap_anon, 3},
+#endif
+    [SYS_RING_ENTER] = {sys_ring_enter, 1},
+  };
+
+/* An open file. */
+struct file_descriptor 
+  {
+    struct list_elem elem;      /* List element. */
+    struct file *file;          /* File. */
+    int handle;                 /* File handle. */
+  };
+
+/* A memory-mapped file, or anonymous memory. */
+struct mapping 
+  {
+    struct list_elem elem;      /* List element. */
+    int handle;                 /* Mapping id. */
+    struct file *file;          /* File, or null if anonymous. */
+    uint8_t *base;              /* Start of memory mapping. */
+    size_t page_cnt;            /* Number of pages mapped. */
+  };
+
+/* Flags for mmap_anon(), as in lib/user/syscall.h. */
+#define MAP_LARGE 0x1           /* Use 4 MB pages where possible. */
+
+/* Size of the kernel buffer that read() and write() copy file
+   data through, so that no frame or file system lock is held
+   while user memory is touched. */
+#define BOUNCE_SIZE 512
+
+/* Statistics. */
+static long long trap_cnt;      /* System calls made by trapping. */
+static long long sysenter_cnt;  /* Of those, traps made by sysenter. */
+static long long ring_call_cnt; /* System calls taken from rings. */
 
 static void syscall_handler (struct intr_frame *);
+static void copy_in (void *dst, const void *usrc, size_t size);
+static void copy_out (void *udst, const void *src, size_t size);
+static char *copy_in_string (const char *us);
+static void terminate (void) NO_RETURN;
 
 void
 syscall_init (void) 
@@ -13,8 +121,889 @@ syscall_init (void)
 }
 
 static void
-syscall_handler (struct intr_frame *f UNUSED) 
+syscall_handler (struct intr_frame *f) 
+{
+  const struct syscall *sc;
+  uint32_t args[SYSCALL_MAX_ARGS];
+  unsigned number;
+
+#ifdef VM
+  thread_current ()->user_esp = f->esp;
+#endif
+  trap_cnt++;
+  copy_in (&number, f->esp, sizeof number);
+  sc = number < sizeof syscalls / sizeof *syscalls ? &syscalls[number] : NULL;
+  if (sc == NULL || sc->func == NULL) 
+    terminate ();
+
+  ASSERT (sc->arg_cnt <= SYSCALL_MAX_ARGS);
+  copy_in (args, (uint32_t *) f->esp + 1, sizeof *args * sc->arg_cnt);
+  f->eax = sc->func (args);
+}
+
+/* Handles a system call made with sysenter.  Called directly by
+   syscall_sysenter (in userprog/sysenter.S) with the same frame
+   that "int $0x30" produces. */
+void
+syscall_sysenter_handler (struct intr_frame *f) 
+{
+  sysenter_cnt++;
+  syscall_handler (f);
+}
+
+/* Returns the kernel address of user address UADDR in the
+   current process, or a null pointer if UADDR is not mapped, or
+   if WRITE is true and it is not writable.  If WRITE is true,
+   the page is also marked dirty, since the kernel's writes
+   through its own mapping don't set the user PTE's dirty bit.
+   With VM, the page is paged in if necessary and locked into
+   memory until unlock_user() is called. */
+static uint8_t *
+lock_user (const void *uaddr, bool write) 
+{
+  uint32_t *pd = thread_current ()->pagedir;
+
+  if (pd == NULL || !is_user_vaddr (uaddr))
+    return NULL;
+#ifdef VM
+  if (!page_lock (uaddr, write))
+    return NULL;
+#else
+  if (pagedir_get_page (pd, uaddr) == NULL
+      || (write && !pagedir_is_writable (pd, pg_round_down (uaddr))))
+    return NULL;
+#endif
+  if (write)
+    pagedir_set_dirty (pd, pg_round_down (uaddr), true);
+  return pagedir_get_page (pd, uaddr);
+}
+
+/* Releases the user page that contains UADDR, which must have
+   been locked with lock_user(). */
+static void
+unlock_user (const void *uaddr UNUSED) 
 {
-  printf ("system call!\n");
+#ifdef VM
+  page_unlock (uaddr);
+#endif
+}
+
+/* Copies SIZE bytes from user address USRC to kernel address
+   DST, a page at a time.
+   Kills the process if any of the user bytes is not mapped. */
+static void
+copy_in (void *dst_, const void *usrc_, size_t size) 
+{
+  uint8_t *dst = dst_;
+  const uint8_t *usrc = usrc_;
+
+  while (size > 0) 
+    {
+      size_t chunk = PGSIZE - pg_ofs (usrc);
+      uint8_t *src = lock_user (usrc, false);
+
+      if (src == NULL)
+        terminate ();
+      if (chunk > size)
+        chunk = size;
+      memcpy (dst, src, chunk);
+      unlock_user (usrc);
+      dst += chunk;
+      usrc += chunk;
+      size -= chunk;
+    }
+}
+
+/* Copies SIZE bytes from kernel address SRC to user address
+   UDST, a page at a time.
+   Kills the process if any of the user bytes is not mapped
+   writable. */
+static void
+copy_out (void *udst_, const void *src_, size_t size) 
+{
+  uint8_t *udst = udst_;
+  const uint8_t *src = src_;
+
+  while (size > 0) 
+    {
+      size_t chunk = PGSIZE - pg_ofs (udst);
+      uint8_t *dst = lock_user (udst, true);
+
+      if (dst == NULL)
+        terminate ();
+      if (chunk > size)
+        chunk = size;
+      memcpy (dst, src, chunk);
+      unlock_user (udst);
+      udst += chunk;
+      src += chunk;
+      size -= chunk;
+    }
+}
+
+/* Creates a copy of user string US in kernel memory and returns
+   it as a page that must be freed with palloc_free_page().
+   Truncates the string at PGSIZE bytes in size.
+   Kills the process if any of the user bytes is not mapped. */
+static char *
+copy_in_string (const char *us) 
+{
+  char *ks;
+  size_t length = 0;
+
+  ks = palloc_get_page (PAL_TAG (MEM_FILE));
+  if (ks == NULL)
+    terminate ();
+
+  while (length < PGSIZE) 
+    {
+      const char *usrc = us + length;
+      size_t chunk = PGSIZE - pg_ofs (usrc);
+      const char *src = (const char *) lock_user (usrc, false);
+      size_t i;
+
+      if (src == NULL) 
+        {
+          palloc_free_page (ks);
+          terminate ();
+        }
+      for (i = 0; i < chunk && length < PGSIZE; i++, length++) 
+        {
+          ks[length] = src[i];
+          if (ks[length] == '\0') 
+            {
+              unlock_user (usrc);
+              return ks;
+            }
+        }
+      unlock_user (usrc);
+    }
+  ks[PGSIZE - 1] = '\0';
+  return ks;
+}
+
+/* Kills the current process with exit status -1. */
+static void
+terminate (void) 
+{
+  printf ("%s: exit(%d)\n", thread_current ()->name, -1);
   thread_exit ();
 }
+
+/* Returns the file descriptor associated with HANDLE, or a null
+   pointer if the current process has no such file open. */
+static struct file_descriptor *
+find_fd (int handle) 
+{
+  struct thread *cur = thread_current ();
+  struct list_elem *e;
+
+  for (e = list_begin (&cur->fds); e != list_end (&cur->fds);
+       e = list_next (e))
+    {
+      struct file_descriptor *fd
+        = list_entry (e, struct file_descriptor, elem);
+      if (fd->handle == handle)
+        return fd;
+    }
+  return NULL;
+}
+
+/* Returns the file descriptor associated with HANDLE.
+   Kills the process if HANDLE is not open. */
+static struct file_descriptor *
+lookup_fd (int handle) 
+{
+  struct file_descriptor *fd = find_fd (handle);
+  if (fd == NULL)
+    terminate ();
+  return fd;
+}
+
+/* Halt system call. */
+static uint32_t
+sys_halt (const uint32_t args[] UNUSED) 
+{
+  shutdown_power_off ();
+}
+
+/* Exit system call: terminates the process with status
+   ARGS[0]. */
+static uint32_t
+sys_exit (const uint32_t args[]) 
+{
+  printf ("%s: exit(%d)\n", thread_current ()->name, (int) args[0]);
+  thread_exit ();
+}
+
+/* Create system call: creates file ARGS[0] with initial size
+   ARGS[1]. */
+static uint32_t
+sys_create (const uint32_t args[]) 
+{
+  char *kfile = copy_in_string ((const char *) args[0]);
+  bool ok;
+
+  lock_acquire (&filesys_lock);
+  ok = filesys_create (kfile, args[1]);
+  lock_release (&filesys_lock);
+
+  palloc_free_page (kfile);
+  return ok;
+}
+
+/* Remove system call: deletes file ARGS[0]. */
+static uint32_t
+sys_remove (const uint32_t args[]) 
+{
+  char *kfile = copy_in_string ((const char *) args[0]);
+  bool ok;
+
+  lock_acquire (&filesys_lock);
+  ok = filesys_remove (kfile);
+  lock_release (&filesys_lock);
+
+  palloc_free_page (kfile);
+  return ok;
+}
+
+/* Open system call: opens file ARGS[0] and returns a handle for
+   it, or -1 on failure. */
+static uint32_t
+sys_open (const uint32_t args[]) 
+{
+  struct thread *cur = thread_current ();
+  char *kfile = copy_in_string ((const char *) args[0]);
+  struct file_descriptor *fd;
+  int handle = -1;
+
+  fd = malloc_tagged (sizeof *fd, MEM_FILE);
+  if (fd != NULL)
+    {
+      lock_acquire (&filesys_lock);
+      fd->file = filesys_open (kfile);
+      lock_release (&filesys_lock);
+      if (fd->file != NULL)
+        {
+          handle = fd->handle = cur->next_handle++;
+          list_push_front (&cur->fds, &fd->elem);
+        }
+      else 
+        free (fd);
+    }
+
+  palloc_free_page (kfile);
+  return handle;
+}
+
+/* Filesize system call: returns the size of open file
+   ARGS[0]. */
+static uint32_t
+sys_filesize (const uint32_t args[]) 
+{
+  struct file_descriptor *fd = lookup_fd (args[0]);
+  off_t size;
+
+  lock_acquire (&filesys_lock);
+  size = file_length (fd->file);
+  lock_release (&filesys_lock);
+  return size;
+}
+
+/* Reads up to SIZE bytes of FILE, starting at its current
+   position, into user buffer UDST, and advances the position.
+   Returns the number of bytes read.  Under VM, the data is
+   copied out of the page cache. */
+static off_t
+read_file (struct file *file, uint8_t *udst, unsigned size) 
+{
+  uint8_t buf[BOUNCE_SIZE];
+  off_t pos, length, total = 0;
+
+  lock_acquire (&filesys_lock);
+  pos = file_tell (file);
+  length = file_length (file);
+  lock_release (&filesys_lock);
+
+  while (size > 0 && pos < length) 
+    {
+      off_t chunk = size < BOUNCE_SIZE ? size : BOUNCE_SIZE;
+#ifdef VM
+      off_t page_ofs = pos - pos % PGSIZE;
+      struct frame *f;
+
+      if (chunk > page_ofs + PGSIZE - pos)
+        chunk = page_ofs + PGSIZE - pos;
+      if (chunk > length - pos)
+        chunk = length - pos;
+      f = cache_lock (file_get_inode (file), page_ofs);
+      if (f == NULL)
+        break;
+      memcpy (buf, (uint8_t *) f->kpage + (pos - page_ofs), chunk);
+      frame_unlock (f);
+#else
+      lock_acquire (&filesys_lock);
+      chunk = file_read_at (file, buf, chunk, pos);
+      lock_release (&filesys_lock);
+      if (chunk == 0)
+        break;
+#endif
+      copy_out (udst, buf, chunk);
+      udst += chunk;
+      pos += chunk;
+      size -= chunk;
+      total += chunk;
+    }
+
+  lock_acquire (&filesys_lock);
+  file_seek (file, pos);
+  lock_release (&filesys_lock);
+  return total;
+}
+
+/* Read system call: reads up to ARGS[2] bytes from handle
+   ARGS[0] into ARGS[1].  Returns the number of bytes read. */
+static uint32_t
+sys_read (const uint32_t args[]) 
+{
+  uint8_t *udst = (uint8_t *) args[1];
+  unsigned size = args[2];
+  unsigned i;
+
+  if (args[0] != STDIN_FILENO)
+    return read_file (lookup_fd (args[0])->file, udst, size);
+
+  for (i = 0; i < size; i++) 
+    {
+      uint8_t c = input_getc ();
+      copy_out (udst + i, &c, 1);
+    }
+  return size;
+}
+
+/* Write system call: writes ARGS[2] bytes from ARGS[1] to
+   handle ARGS[0].  Returns the number of bytes written. */
+static uint32_t
+sys_write (const uint32_t args[]) 
+{
+  const uint8_t *usrc = (const uint8_t *) args[1];
+  unsigned size = args[2];
+  struct file_descriptor *fd = NULL;
+  uint8_t buf[BOUNCE_SIZE];
+  off_t total = 0;
+
+  if (args[0] != STDOUT_FILENO)
+    fd = lookup_fd (args[0]);
+
+  while (size > 0) 
+    {
+      off_t chunk = size < BOUNCE_SIZE ? size : BOUNCE_SIZE;
+      off_t pos UNUSED, written;
+
+      copy_in (buf, usrc, chunk);
+      if (fd == NULL) 
+        {
+          putbuf ((const char *) buf, chunk);
+          written = chunk;
+        }
+      else 
+        {
+          lock_acquire (&filesys_lock);
+          pos = file_tell (fd->file);
+          written = file_write (fd->file, buf, chunk);
+          lock_release (&filesys_lock);
+#ifdef VM
+          /* Bring any cached copy up to date, a page at a time. */
+          {
+            off_t done = 0;
+            while (done < written) 
+              {
+                off_t part = PGSIZE - (pos + done) % PGSIZE;
+                if (part > written - done)
+                  part = written - done;
+                cache_update (file_get_inode (fd->file), pos + done,
+                              buf + done, part);
+                done += part;
+              }
+          }
+#endif
+        }
+
+      total += written;
+      if (written < chunk)
+        break;
+      usrc += chunk;
+      size -= chunk;
+    }
+  return total;
+}
+
+/* Seek system call: sets the position of handle ARGS[0] to
+   ARGS[1]. */
+static uint32_t
+sys_seek (const uint32_t args[]) 
+{
+  struct file_descriptor *fd = lookup_fd (args[0]);
+
+  lock_acquire (&filesys_lock);
+  if ((off_t) args[1] >= 0)
+    file_seek (fd->file, args[1]);
+  lock_release (&filesys_lock);
+  return 0;
+}
+
+/* Tell system call: returns the position of handle ARGS[0]. */
+static uint32_t
+sys_tell (const uint32_t args[]) 
+{
+  struct file_descriptor *fd = lookup_fd (args[0]);
+  off_t pos;
+
+  lock_acquire (&filesys_lock);
+  pos = file_tell (fd->file);
+  lock_release (&filesys_lock);
+  return pos;
+}
+
+/* Close system call: closes handle ARGS[0]. */
+static uint32_t
+sys_close (const uint32_t args[]) 
+{
+  struct file_descriptor *fd = lookup_fd (args[0]);
+
+  lock_acquire (&filesys_lock);
+  file_close (fd->file);
+  lock_release (&filesys_lock);
+  list_remove (&fd->elem);
+  free (fd);
+  return 0;
+}
+
+#ifdef VM
+/* Returns the mapping with id HANDLE in the current process, or
+   a null pointer if there is none. */
+static struct mapping *
+find_mapping (int handle) 
+{
+  struct thread *cur = thread_current ();
+  struct list_elem *e;
+
+  for (e = list_begin (&cur->mappings); e != list_end (&cur->mappings);
+       e = list_next (e))
+    {
+      struct mapping *m = list_entry (e, struct mapping, elem);
+      if (m->handle == handle)
+        return m;
+    }
+  return NULL;
+}
+
+/* Removes the first PAGE_CNT pages of mapping M, writing back
+   any of a file that were modified.  Their frames stay in the page cache
+   until they are evicted. */
+static void
+unmap_pages (struct mapping *m, size_t page_cnt) 
+{
+  struct tlb_batch batch;
+  size_t i;
+
+  pagedir_batch_init (&batch);
+  for (i = 0; i < page_cnt; i++)
+    page_remove (m->base + i * PGSIZE, &batch);
+  pagedir_flush (&batch);
+}
+
+/* Removes mapping M and frees it. */
+static void
+unmap (struct mapping *m) 
+{
+  list_remove (&m->elem);
+  unmap_pages (m, m->page_cnt);
+  lock_acquire (&filesys_lock);
+  file_close (m->file);
+  lock_release (&filesys_lock);
+  free (m);
+}
+
+/* Mmap system call: maps the file open as handle ARGS[0] at
+   user address ARGS[1].  Returns a mapping id, or -1 if the file
+   is empty or the range is unaligned or overlaps pages that are
+   already mapped. */
+static uint32_t
+sys_mmap (const uint32_t args[]) 
+{
+  struct thread *cur = thread_current ();
+  struct file_descriptor *fd = find_fd (args[0]);
+  uint8_t *base = (uint8_t *) args[1];
+  struct mapping *m;
+  off_t length;
+  size_t i;
+
+  if (fd == NULL || base == NULL || pg_ofs (base) != 0)
+    return -1;
+
+  m = malloc_tagged (sizeof *m, MEM_FILE);
+  if (m == NULL)
+    return -1;
+  lock_acquire (&filesys_lock);
+  m->file = file_reopen (fd->file);
+  length = m->file != NULL ? file_length (m->file) : 0;
+  lock_release (&filesys_lock);
+  m->base = base;
+  m->page_cnt = DIV_ROUND_UP (length, PGSIZE);
+
+  for (i = 0; i < m->page_cnt; i++) 
+    {
+      uint8_t *upage = base + i * PGSIZE;
+      if (!is_user_vaddr (upage) || page_lookup (cur, upage) != NULL
+          || !page_add_shared (upage, m->file, i * PGSIZE, true))
+        break;
+    }
+  if (length == 0 || i < m->page_cnt) 
+    {
+      unmap_pages (m, i);
+      lock_acquire (&filesys_lock);
+      file_close (m->file);
+      lock_release (&filesys_lock);
+      free (m);
+      return -1;
+    }
+
+  m->handle = cur->next_mapid++;
+  list_push_front (&cur->mappings, &m->elem);
+  return m->handle;
+}
+
+/* Fork system call: creates a copy of the current process.
+   Returns the child's pid in the parent, 0 in the child, or -1
+   on failure. */
+static uint32_t
+sys_fork (const uint32_t args[] UNUSED) 
+{
+  /* A process that enters the kernel from user mode does so on
+     an empty kernel stack, so its user context is the interrupt
+     frame at the very top of its thread's page. */
+  struct intr_frame *if_ = ((struct intr_frame *)
+                            ((uint8_t *) thread_current () + PGSIZE)) - 1;
+  return process_fork (if_);
+}
+
+/* Munmap system call: removes mapping ARGS[0]. */
+static uint32_t
+sys_munmap (const uint32_t args[]) 
+{
+  struct mapping *m = find_mapping (args[0]);
+  if (m == NULL)
+    terminate ();
+  unmap (m);
+  return 0;
+}
+
+/* Mmap_anon system call: maps ARGS[1] bytes of zeros, rounded
+   up to whole pages, at user address ARGS[0].  With MAP_LARGE
+   in ARGS[2], each 4 MB-aligned 4 MB part of the region is
+   mapped with a large page, if memory allows.  Returns a mapping
+   id, or -1 if the range is empty, unaligned, or overlaps pages
+   that are already mapped. */
+static uint32_t
+sys_mmap_anon (const uint32_t args[]) 
+{
+  struct thread *cur = thread_current ();
+  uint8_t *base = (uint8_t *) args[0];
+  size_t size = args[1];
+  uint8_t *large, *end;
+  struct mapping *m;
+  size_t i;
+
+  if (base == NULL || pg_ofs (base) != 0 || size == 0
+      || !is_user_vaddr (base)
+      || size > (size_t) ((uint8_t *) PHYS_BASE - base))
+    return -1;
+
+  m = malloc_tagged (sizeof *m, MEM_FILE);
+  if (m == NULL)
+    return -1;
+  m->file = NULL;
+  m->base = base;
+  m->page_cnt = DIV_ROUND_UP (size, PGSIZE);
+
+  for (i = 0; i < m->page_cnt; i++) 
+    {
+      uint8_t *upage = base + i * PGSIZE;
+      if (page_lookup (cur, upage) != NULL || !page_add_zero (upage, true))
+        break;
+    }
+  if (i < m->page_cnt) 
+    {
+      unmap_pages (m, i);
+      free (m);
+      return -1;
+    }
+
+  end = base + m->page_cnt * PGSIZE;
+  if (args[2] & MAP_LARGE)
+    for (large = (uint8_t *) ROUND_UP ((uintptr_t) base, PTSPAN);
+         large < end && (size_t) (end - large) >= PTSPAN; large += PTSPAN)
+      page_make_large (large);
+
+  m->handle = cur->next_mapid++;
+  list_push_front (&cur->mappings, &m->elem);
+  return m->handle;
+}
+
+/* Vmstat system call: stores the current process's memory use
+   into the struct vmstat at ARGS[0]. */
+static uint32_t
+sys_vmstat (const uint32_t args[]) 
+{
+  struct thread *cur = thread_current ();
+  struct vmstat stat;
+
+  memset (&stat, 0, sizeof stat);
+  stat.rss = cur->rss;
+  stat.peak_rss = cur->peak_rss;
+  stat.working_set = cur->wss;
+  stat.rss_limit = cur->rss_limit;
+  copy_out ((void *) args[0], &stat, sizeof stat);
+  return 0;
+}
+
+/* Rsslimit system call: limits the current process's resident
+   set to ARGS[0] pages, or removes the limit if ARGS[0] is 0.
+   Returns the old limit, or -1 if ARGS[0] is negative. */
+static uint32_t
+sys_rsslimit (const uint32_t args[]) 
+{
+  if ((int) args[0] < 0)
+    return -1;
+  return frame_set_rss_limit (args[0]);
+}
+#endif /* VM */
+
+/* Memstat system call: stores the usage charged to tag ARGS[0]
+   into the struct memstat at ARGS[1].  Returns false if there is
+   no such tag. */
+static uint32_t
+sys_memstat (const uint32_t args[]) 
+{
+  enum mem_tag tag = args[0];
+  struct memstat stat;
+  size_t pages, peak_pages, bytes, peak_bytes;
+
+  if (args[0] >= MEM_TAG_CNT)
+    return false;
+
+  palloc_get_stats (tag, &pages, &peak_pages);
+  malloc_get_stats (tag, &bytes, &peak_bytes);
+  memset (&stat, 0, sizeof stat);
+  strlcpy (stat.name, mem_tag_name (tag), sizeof stat.name);
+  stat.pages = pages;
+  stat.peak_pages = peak_pages;
+  stat.bytes = bytes;
+  stat.peak_bytes = peak_bytes;
+  copy_out ((void *) args[1], &stat, sizeof stat);
+  return true;
+}
+
+/* Ring_enter system call: carries out, in order, the system
+   calls queued in the submission queue of the struct ring at
+   ARGS[0], as many as there is room for in its completion queue,
+   and puts their results there.  Only system calls marked
+   ringable in the syscalls table may be queued; any other gets
+   result -1.  A queued call that would kill the process if it
+   were made directly kills it here too.  Returns the number of
+   calls taken from the submission queue, or -1 if the ring's
+   indexes are inconsistent. */
+static uint32_t
+sys_ring_enter (const uint32_t args[]) 
+{
+  struct ring *ring = (struct ring *) args[0];
+  unsigned sq_head, sq_tail, cq_head, cq_tail;
+  unsigned cnt = 0;
+
+  copy_in (&sq_head, &ring->sq_head, sizeof sq_head);
+  copy_in (&sq_tail, &ring->sq_tail, sizeof sq_tail);
+  copy_in (&cq_head, &ring->cq_head, sizeof cq_head);
+  copy_in (&cq_tail, &ring->cq_tail, sizeof cq_tail);
+  if (sq_tail - sq_head > RING_SIZE || cq_tail - cq_head > RING_SIZE)
+    return -1;
+
+  while (sq_head != sq_tail && cq_tail - cq_head < RING_SIZE) 
+    {
+      struct ring_sqe sqe;
+      struct ring_cqe cqe;
+      const struct syscall *sc = NULL;
+
+      copy_in (&sqe, &ring->sq[sq_head % RING_SIZE], sizeof sqe);
+      if (sqe.number < sizeof syscalls / sizeof *syscalls)
+        sc = &syscalls[sqe.number];
+
+      cqe.user_data = sqe.user_data;
+      if (sc != NULL && sc->ringable)
+        cqe.result = sc->func (sqe.args);
+      else
+        cqe.result = -1;
+      copy_out (&ring->cq[cq_tail % RING_SIZE], &cqe, sizeof cqe);
+      sq_head++;
+      cq_tail++;
+      cnt++;
+    }
+  ring_call_cnt += cnt;
+
+  copy_out (&ring->sq_head, &sq_head, sizeof sq_head);
+  copy_out (&ring->cq_tail, &cq_tail, sizeof cq_tail);
+  return cnt;
+}
+
+/* Removes the current process's memory mappings and closes its
+   open files.  Called as the process exits. */
+void
+syscall_exit (void) 
+{
+  struct thread *cur = thread_current ();
+
+#ifdef VM
+  while (!list_empty (&cur->mappings))
+    unmap (list_entry (list_front (&cur->mappings), struct mapping, elem));
+#endif
+  while (!list_empty (&cur->fds)) 
+    {
+      struct file_descriptor *fd
+        = list_entry (list_pop_front (&cur->fds), struct file_descriptor,
+                      elem);
+      lock_acquire (&filesys_lock);
+      file_close (fd->file);
+      lock_release (&filesys_lock);
+      free (fd);
+    }
+}
+
+#ifdef VM
+/* Removes from the current process, which is being created by
+   fork(), its copies of the pages of PARENT's mappings from E
+   onward, which still refer to PARENT's files. */
+static void
+remove_parent_pages (struct thread *parent, struct list_elem *e) 
+{
+  struct thread *cur = thread_current ();
+  struct tlb_batch batch;
+
+  pagedir_batch_init (&batch);
+  for (; e != list_end (&parent->mappings); e = list_next (e)) 
+    {
+      struct mapping *pm = list_entry (e, struct mapping, elem);
+      size_t i;
+
+      for (i = 0; i < pm->page_cnt; i++) 
+        {
+          uint8_t *upage = pm->base + i * PGSIZE;
+          if (page_lookup (cur, upage) != NULL)
+            page_remove (upage, &batch);
+        }
+    }
+  pagedir_flush (&batch);
+}
+#endif
+
+/* Gives the current process, which PARENT is creating with
+   fork(), its own handles for PARENT's memory mappings and open
+   files, with the same numbers.  The pages of the mappings must
+   already have been copied by page_table_copy().  Returns true
+   if successful, false if memory is not available.  On failure,
+   no page of the current process refers to any of PARENT's
+   files. */
+bool
+syscall_fork (struct thread *parent) 
+{
+  struct thread *cur = thread_current ();
+  struct list_elem *e;
+#ifdef VM
+  struct mapping *m = NULL;
+
+  for (e = list_begin (&parent->mappings); e != list_end (&parent->mappings);
+       e = list_next (e))
+    {
+      struct mapping *pm = list_entry (e, struct mapping, elem);
+      size_t i;
+
+      m = malloc_tagged (sizeof *m, MEM_FILE);
+      if (m == NULL)
+        goto fail;
+      m->file = NULL;
+      if (pm->file != NULL) 
+        {
+          lock_acquire (&filesys_lock);
+          m->file = file_reopen (pm->file);
+          lock_release (&filesys_lock);
+          if (m->file == NULL) 
+            goto fail;
+        }
+      m->handle = pm->handle;
+      m->base = pm->base;
+      m->page_cnt = pm->page_cnt;
+      for (i = 0; i < m->page_cnt; i++) 
+        {
+          struct page *p = page_lookup (cur, m->base + i * PGSIZE);
+          if (p == NULL)
+            goto fail;
+          p->file = m->file;
+        }
+      list_push_back (&cur->mappings, &m->elem);
+    }
+  cur->next_mapid = parent->next_mapid;
+#endif
+
+  /* With the mappings in place, a failure from here on leaves
+     the current process in a state that process_exit() can tear
+     down. */
+  for (e = list_begin (&parent->fds); e != list_end (&parent->fds);
+       e = list_next (e))
+    {
+      struct file_descriptor *pfd
+        = list_entry (e, struct file_descriptor, elem);
+      struct file_descriptor *fd = malloc_tagged (sizeof *fd, MEM_FILE);
+      if (fd == NULL)
+        return false;
+      lock_acquire (&filesys_lock);
+      fd->file = file_reopen (pfd->file);
+      if (fd->file != NULL)
+        file_seek (fd->file, file_tell (pfd->file));
+      lock_release (&filesys_lock);
+      if (fd->file == NULL) 
+        {
+          free (fd);
+          return false;
+        }
+      fd->handle = pfd->handle;
+      list_push_back (&cur->fds, &fd->elem);
+    }
+  cur->next_handle = parent->next_handle;
+  return true;
+
+#ifdef VM
+ fail:
+  /* Drop the pages of the mapping that failed, M, and of those
+     after it, some of which may already refer to M's file, before
+     closing that file.  Then unwind the mappings already copied. */
+  remove_parent_pages (parent, e);
+  if (m != NULL) 
+    {
+      lock_acquire (&filesys_lock);
+      file_close (m->file);
+      lock_release (&filesys_lock);
+      free (m);
+    }
+  while (!list_empty (&cur->mappings))
+    unmap (list_entry (list_front (&cur->mappings), struct mapping, elem));
+  return false;
+#endif
+}
+
+/* Prints system call statistics. */
+void
+syscall_print_stats (void) 
+{
+  printf ("Syscall: %lld traps (%lld by sysenter), "
+          "%lld calls from rings\n",
+          trap_cnt, sysenter_cnt, ring_call_cnt);
+}
@@ -1,6 +1,18 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 
+#include <stdbool.h>
+
+struct intr_frame;
+struct thread;
+
 void syscall_init (void);
+bool syscall_fork (struct thread *parent);
+void syscall_exit (void);
+void syscall_print_stats (void);
+
+/* Entry point for sysenter, in userprog/sysenter.S. */
+void syscall_sysenter (void);
+void syscall_sysenter_handler (struct intr_frame *);
 
 #endif /* userprog/syscall.h */
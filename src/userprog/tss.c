@@ -2,6 +2,8 @@
 #include <debug.h>
 #include <stddef.h>
 #include "userprog/gdt.h"
+#include "userprog/syscall.h"
+#include "threads/cpu.h"
 #include "threads/thread.h"
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
@@ -75,6 +77,14 @@ struct tss
 /* Kernel TSS. */
 static struct tss *tss;
 
+/* Stack that sysenter switches to.  Its top word is kept equal
+   to esp0 by tss_update(), for syscall_sysenter to load as its
+   real stack pointer.  The rest is room for the debug exception
+   that a process single-stepping into sysenter takes on
+   syscall_sysenter's first instruction (see exception.c). */
+static uint32_t sysenter_stack[256];
+#define SYSENTER_TOP (&sysenter_stack[255])
+
 /* Initializes the kernel TSS. */
 void
 tss_init (void) 
@@ -86,6 +96,18 @@ tss_init (void)
   tss->ss0 = SEL_KDSEG;
   tss->bitmap = 0xdfff;
   tss_update ();
+
+  /* Let user processes make system calls with sysenter.  Unlike
+     an interrupt, sysenter takes its stack pointer from an MSR
+     that we can't afford to rewrite on every thread switch, so
+     we point it at sysenter_stack and syscall_sysenter loads the
+     real stack pointer from there. */
+  if (cpu_has (CPUID_SEP)) 
+    {
+      wrmsr (MSR_SYSENTER_CS, SEL_KCSEG);
+      wrmsr (MSR_SYSENTER_ESP, (uint32_t) SYSENTER_TOP);
+      wrmsr (MSR_SYSENTER_EIP, (uint32_t) syscall_sysenter);
+    }
 }
 
 /* Returns the kernel TSS. */
@@ -103,4 +125,5 @@ tss_update (void)
 {
   ASSERT (tss != NULL);
   tss->esp0 = (uint8_t *) thread_current () + PGSIZE;
+  *SYSENTER_TOP = (uint32_t) tss->esp0;
 }
@@ -0,0 +1,268 @@
+#include "vm/cache.h"
+#include <debug.h>
+#include <hash.h>
+#include <string.h>
+#include "vm/frame.h"
+#include "filesys/filesys.h"
+#include "filesys/inode.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Page cache.
+
+   Pages of files, keyed by inode and page-aligned offset, held
+   in frames from the frame table.  Memory-mapped files map these
+   frames directly, and the read() system call copies out of
+   them, so a file that is both read and mapped is in memory only
+   once.  Cached pages compete for frames with private pages and
+   are evicted by the same replacement policy.
+
+   Writes through write() go straight to the file and are then
+   copied into the cached page, if there is one, so a cached page
+   is never newer than the file except through a writable
+   mapping.  Those changes are written back when the mapping is
+   removed or the page is evicted. */
+
+/* Cached pages, as struct frame. */
+static struct hash cache;
+
+/* Protects CACHE.  When acquired with a frame lock, the frame
+   lock must be acquired first. */
+static struct lock table_lock;
+
+static hash_hash_func cache_hash;
+static hash_less_func cache_less;
+static struct frame *lookup (struct inode *, off_t ofs);
+static bool insert (struct frame *, struct inode *, off_t ofs);
+static void read_page (struct frame *);
+
+/* Initializes the page cache. */
+void
+cache_init (void) 
+{
+  hash_init (&cache, cache_hash, cache_less, NULL);
+  lock_init (&table_lock);
+}
+
+/* Returns the page of INODE at OFS, which must be page-aligned,
+   in a locked frame, reading it in if it is not already cached.
+   The part of the page beyond the end of the file is zeros.
+   Returns a null pointer if no frame is available. */
+struct frame *
+cache_lock (struct inode *inode, off_t ofs) 
+{
+  for (;;) 
+    {
+      struct frame *f = cache_lock_cached (inode, ofs);
+      if (f != NULL) 
+        {
+          f->accessed = true;
+          return f;
+        }
+
+      f = frame_alloc_and_lock (NULL);
+      if (f == NULL)
+        return NULL;
+      if (insert (f, inode, ofs)) 
+        {
+          read_page (f);
+          return f;
+        }
+    }
+}
+
+/* Returns the page of INODE at OFS, which must be page-aligned,
+   in a locked frame, if it is cached, otherwise a null pointer.
+   Unlike cache_lock(), does not count as an access. */
+struct frame *
+cache_lock_cached (struct inode *inode, off_t ofs) 
+{
+  ASSERT (ofs % PGSIZE == 0);
+
+  for (;;) 
+    {
+      struct frame *f;
+
+      lock_acquire (&table_lock);
+      f = lookup (inode, ofs);
+      lock_release (&table_lock);
+      if (f == NULL)
+        return NULL;
+
+      /* The frame may be evicted and reused while we wait. */
+      lock_acquire (&f->lock);
+      if (f->inode == inode && f->ofs == ofs) 
+        return f;
+      lock_release (&f->lock);
+    }
+}
+
+/* Reads the page of INODE at OFS, which must be page-aligned,
+   into the cache if it is not already there and a frame is free
+   to hold it.  It is left marked as not accessed, so that it is
+   the first to go again if it is not used.  Returns false if no
+   frame was free, true otherwise. */
+bool
+cache_read_ahead (struct inode *inode, off_t ofs) 
+{
+  struct frame *f;
+  bool cached;
+
+  ASSERT (ofs % PGSIZE == 0);
+
+  lock_acquire (&table_lock);
+  cached = lookup (inode, ofs) != NULL;
+  lock_release (&table_lock);
+  if (cached)
+    return true;
+
+  f = frame_alloc_free_and_lock (NULL);
+  if (f == NULL)
+    return false;
+  if (insert (f, inode, ofs)) 
+    {
+      read_page (f);
+      f->accessed = false;
+      frame_unlock (f);
+    }
+  return true;
+}
+
+/* Copies the SIZE bytes at DATA, just written to INODE at OFS,
+   into the cached page that contains them, if there is one.
+   They must lie within a single page. */
+void
+cache_update (struct inode *inode, off_t ofs, const void *data,
+              size_t size) 
+{
+  off_t page_ofs = ofs - ofs % PGSIZE;
+  struct frame *f;
+
+  ASSERT (ofs - page_ofs + size <= PGSIZE);
+
+  lock_acquire (&table_lock);
+  f = lookup (inode, page_ofs);
+  lock_release (&table_lock);
+  if (f == NULL)
+    return;
+
+  lock_acquire (&f->lock);
+  if (f->inode == inode && f->ofs == page_ofs)
+    memcpy ((uint8_t *) f->kpage + (ofs - page_ofs), data, size);
+  lock_release (&f->lock);
+}
+
+/* Writes page cache frame F, which must be locked, back to its
+   file, except for any part beyond the end of the file. */
+void
+cache_write_back (struct frame *f) 
+{
+  off_t size;
+
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  ASSERT (f->inode != NULL);
+
+  lock_acquire (&filesys_lock);
+  size = inode_length (f->inode) - f->ofs;
+  if (size > PGSIZE)
+    size = PGSIZE;
+  if (size > 0)
+    inode_write_at (f->inode, f->kpage, size, f->ofs);
+  lock_release (&filesys_lock);
+}
+
+/* Removes page cache frame F, which must be locked and no longer
+   mapped by any process, from the cache, first writing it back
+   if DIRTY is true. */
+void
+cache_evict (struct frame *f, bool dirty) 
+{
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  ASSERT (f->inode != NULL);
+
+  if (dirty)
+    cache_write_back (f);
+
+  lock_acquire (&table_lock);
+  hash_delete (&cache, &f->cache_elem);
+  lock_release (&table_lock);
+
+  lock_acquire (&filesys_lock);
+  inode_close (f->inode);
+  lock_release (&filesys_lock);
+  f->inode = NULL;
+}
+
+/* Enters frame F, which must be locked and free, in the cache
+   as the page of INODE at OFS.  If someone else cached that page
+   first, frees F and returns false.  Otherwise returns true, and
+   the caller must read the page with read_page() before
+   unlocking F. */
+static bool
+insert (struct frame *f, struct inode *inode, off_t ofs) 
+{
+  lock_acquire (&table_lock);
+  if (lookup (inode, ofs) != NULL) 
+    {
+      lock_release (&table_lock);
+      frame_free (f);
+      return false;
+    }
+  f->inode = inode_reopen (inode);
+  f->ofs = ofs;
+  f->accessed = true;
+  hash_insert (&cache, &f->cache_elem);
+  lock_release (&table_lock);
+  return true;
+}
+
+/* Reads the contents of page cache frame F, which must be locked,
+   from its file.  Anyone else who wants the page waits on the
+   frame lock until it is read. */
+static void
+read_page (struct frame *f) 
+{
+  off_t read;
+
+  lock_acquire (&filesys_lock);
+  read = inode_read_at (f->inode, f->kpage, PGSIZE, f->ofs);
+  lock_release (&filesys_lock);
+  memset ((uint8_t *) f->kpage + read, 0, PGSIZE - read);
+}
+
+/* Returns the cached frame for INODE at OFS, or a null pointer
+   if there is none.  TABLE_LOCK must be held. */
+static struct frame *
+lookup (struct inode *inode, off_t ofs) 
+{
+  struct frame key;
+  struct hash_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&table_lock));
+
+  key.inode = inode;
+  key.ofs = ofs;
+  e = hash_find (&cache, &key.cache_elem);
+  return e != NULL ? hash_entry (e, struct frame, cache_elem) : NULL;
+}
+
+/* Returns a hash value for the frame that E refers to. */
+static unsigned
+cache_hash (const struct hash_elem *e, void *aux UNUSED) 
+{
+  const struct frame *f = hash_entry (e, struct frame, cache_elem);
+  return hash_bytes (&f->inode, sizeof f->inode) ^ hash_int (f->ofs);
+}
+
+/* Returns true if frame A precedes frame B. */
+static bool
+cache_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED) 
+{
+  const struct frame *a = hash_entry (a_, struct frame, cache_elem);
+  const struct frame *b = hash_entry (b_, struct frame, cache_elem);
+
+  if (a->inode != b->inode)
+    return a->inode < b->inode;
+  return a->ofs < b->ofs;
+}
@@ -0,0 +1,19 @@
+#ifndef VM_CACHE_H
+#define VM_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+
+struct frame;
+struct inode;
+
+void cache_init (void);
+struct frame *cache_lock (struct inode *, off_t ofs);
+struct frame *cache_lock_cached (struct inode *, off_t ofs);
+bool cache_read_ahead (struct inode *, off_t ofs);
+void cache_update (struct inode *, off_t ofs, const void *, size_t size);
+void cache_write_back (struct frame *);
+void cache_evict (struct frame *, bool dirty);
+
+#endif /* vm/cache.h */
@@ -0,0 +1,607 @@
+#include "vm/evict.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+
+/* Page replacement policies.
+
+   Each policy learns which frames are in use from the references
+   that the frame table reports, which come from sampling the
+   accessed bits of the pages in each frame.  A frame that is
+   referenced several times between samples is referenced only
+   once, as far as the policy can tell.
+
+   "clock" is the second chance algorithm: a hand sweeps around
+   the table, clearing each frame's reference bit and choosing
+   the first frame whose bit was already clear.
+
+   "lru2" is LRU-2: it evicts the frame whose second most recent
+   reference is oldest, so that a page touched only once, as by
+   a sequential scan, goes before a page that is used over and
+   over, however recently the scan touched it.
+
+   "arc" is the Adaptive Replacement Cache: pages referenced
+   once live on list T1 and pages referenced again on T2.  Each
+   list has a "ghost" list, B1 and B2, of the keys of pages
+   recently evicted from it.  A miss on a page found on B1 means
+   T1 was too small, so its target size P grows, and a miss found
+   on B2 makes it shrink. */
+
+/* Clock. */
+
+static size_t clock_cnt;        /* Number of frames. */
+static size_t clock_hand;       /* Next frame to consider. */
+static bool *clock_ref;         /* Reference bit for each frame. */
+
+static bool
+clock_init (size_t frame_cnt)
+{
+  clock_cnt = frame_cnt;
+  clock_ref = calloc_tagged (frame_cnt, sizeof *clock_ref, MEM_VM);
+  return clock_ref != NULL;
+}
+
+static void
+clock_fill (size_t idx, uintptr_t key UNUSED)
+{
+  clock_ref[idx] = false;
+}
+
+static void
+clock_reference (size_t idx)
+{
+  clock_ref[idx] = true;
+}
+
+static size_t
+clock_candidate (bool (*passed) (size_t))
+{
+  size_t i;
+
+  /* Two trips around the clock clear every bit that was set. */
+  for (i = 0; i < clock_cnt * 2; i++)
+    {
+      size_t idx = clock_hand;
+      if (++clock_hand >= clock_cnt)
+        clock_hand = 0;
+
+      if (passed (idx))
+        continue;
+      if (!clock_ref[idx])
+        return idx;
+      clock_ref[idx] = false;
+    }
+  return EVICT_NONE;
+}
+
+static void
+clock_evicted (size_t idx, uintptr_t key UNUSED)
+{
+  clock_ref[idx] = false;
+}
+
+static void
+clock_freed (size_t idx)
+{
+  clock_ref[idx] = false;
+}
+
+/* LRU-2. */
+
+/* History of a frame's page.  Times are in references, counted
+   across all frames. */
+struct lru2_frame
+  {
+    uint64_t last;              /* Time of last reference. */
+    uint64_t prev;              /* Time of the one before, or 0. */
+    bool used;                  /* Holds a page? */
+    size_t heap_idx;            /* Position in lru2_heap, or
+                                   LRU2_PARKED. */
+    struct list_elem elem;      /* Element in lru2_parked. */
+  };
+
+/* heap_idx of a used frame that is on lru2_parked. */
+#define LRU2_PARKED SIZE_MAX
+
+static struct lru2_frame *lru2_frames;
+static uint64_t lru2_now;       /* Current time. */
+
+/* Used frames, in a binary min-heap ordered by lru2_less(), so
+   that the next candidate is at the top. */
+static size_t *lru2_heap;
+static size_t lru2_heap_cnt;
+
+/* Used frames taken off the heap because the caller passed over
+   them in its current pass.  They go back when it starts a new
+   one, so that each candidate costs O(log n) amortized instead of
+   a scan of every frame. */
+static struct list lru2_parked;
+
+static bool
+lru2_init (size_t frame_cnt)
+{
+  lru2_frames = calloc_tagged (frame_cnt, sizeof *lru2_frames, MEM_VM);
+  lru2_heap = calloc_tagged (frame_cnt, sizeof *lru2_heap, MEM_VM);
+  list_init (&lru2_parked);
+  return lru2_frames != NULL && lru2_heap != NULL;
+}
+
+/* Returns true if frame A should be evicted before frame B: its
+   second most recent reference is older, or the same and its
+   most recent one is older.  Pages referenced only once all have
+   the same second most recent reference. */
+static bool
+lru2_less (size_t a, size_t b)
+{
+  const struct lru2_frame *fa = &lru2_frames[a];
+  const struct lru2_frame *fb = &lru2_frames[b];
+  return (fa->prev < fb->prev
+          || (fa->prev == fb->prev && fa->last < fb->last));
+}
+
+/* Puts frame IDX at position I in the heap. */
+static void
+lru2_heap_set (size_t i, size_t idx)
+{
+  lru2_heap[i] = idx;
+  lru2_frames[idx].heap_idx = i;
+}
+
+/* Moves the frame at position I in the heap up or down until the
+   heap is in order again. */
+static void
+lru2_heap_fix (size_t i)
+{
+  size_t idx = lru2_heap[i];
+
+  while (i > 0 && lru2_less (idx, lru2_heap[(i - 1) / 2]))
+    {
+      lru2_heap_set (i, lru2_heap[(i - 1) / 2]);
+      i = (i - 1) / 2;
+    }
+  for (;;)
+    {
+      size_t child = 2 * i + 1;
+      if (child >= lru2_heap_cnt)
+        break;
+      if (child + 1 < lru2_heap_cnt
+          && lru2_less (lru2_heap[child + 1], lru2_heap[child]))
+        child++;
+      if (!lru2_less (lru2_heap[child], idx))
+        break;
+      lru2_heap_set (i, lru2_heap[child]);
+      i = child;
+    }
+  lru2_heap_set (i, idx);
+}
+
+/* Adds frame IDX to the heap. */
+static void
+lru2_heap_push (size_t idx)
+{
+  lru2_heap_set (lru2_heap_cnt++, idx);
+  lru2_heap_fix (lru2_heap_cnt - 1);
+}
+
+/* Takes used frame IDX off the heap or the parked list. */
+static void
+lru2_unlink (size_t idx)
+{
+  struct lru2_frame *f = &lru2_frames[idx];
+  size_t i = f->heap_idx;
+
+  if (i == LRU2_PARKED)
+    list_remove (&f->elem);
+  else if (i != --lru2_heap_cnt)
+    {
+      lru2_heap_set (i, lru2_heap[lru2_heap_cnt]);
+      lru2_heap_fix (i);
+    }
+}
+
+static void
+lru2_fill (size_t idx, uintptr_t key UNUSED)
+{
+  struct lru2_frame *f = &lru2_frames[idx];
+  if (f->used)
+    lru2_unlink (idx);
+  f->last = ++lru2_now;
+  f->prev = 0;
+  f->used = true;
+  lru2_heap_push (idx);
+}
+
+static void
+lru2_reference (size_t idx)
+{
+  struct lru2_frame *f = &lru2_frames[idx];
+  if (f->used)
+    {
+      f->prev = f->last;
+      f->last = ++lru2_now;
+      if (f->heap_idx != LRU2_PARKED)
+        lru2_heap_fix (f->heap_idx);
+    }
+}
+
+/* Returns the frame at the top of the heap that PASSED does not
+   skip.  Frames that it skips are parked until PASSED stops
+   skipping them, which happens to all of them at once, when the
+   caller starts a new pass. */
+static size_t
+lru2_candidate (bool (*passed) (size_t))
+{
+  if (!list_empty (&lru2_parked))
+    {
+      struct lru2_frame *f = list_entry (list_front (&lru2_parked),
+                                         struct lru2_frame, elem);
+      if (!passed (f - lru2_frames))
+        while (!list_empty (&lru2_parked))
+          {
+            f = list_entry (list_pop_front (&lru2_parked),
+                            struct lru2_frame, elem);
+            lru2_heap_push (f - lru2_frames);
+          }
+    }
+
+  while (lru2_heap_cnt > 0 && passed (lru2_heap[0]))
+    {
+      size_t idx = lru2_heap[0];
+      lru2_unlink (idx);
+      lru2_frames[idx].heap_idx = LRU2_PARKED;
+      list_push_back (&lru2_parked, &lru2_frames[idx].elem);
+    }
+  return lru2_heap_cnt > 0 ? lru2_heap[0] : EVICT_NONE;
+}
+
+static void
+lru2_freed (size_t idx)
+{
+  struct lru2_frame *f = &lru2_frames[idx];
+  if (f->used)
+    {
+      lru2_unlink (idx);
+      f->used = false;
+    }
+}
+
+static void
+lru2_evicted (size_t idx, uintptr_t key UNUSED)
+{
+  lru2_freed (idx);
+}
+
+/* ARC. */
+
+/* Which list an ARC frame or ghost is on. */
+enum arc_list
+  {
+    ARC_NONE,                   /* Free frame or unused ghost. */
+    ARC_T1, ARC_T2,             /* Resident pages. */
+    ARC_B1, ARC_B2              /* Ghosts of evicted pages. */
+  };
+
+/* A frame. */
+struct arc_frame
+  {
+    struct list_elem elem;      /* Element in T1 or T2, or parked. */
+    enum arc_list list;         /* ARC_NONE, ARC_T1, or ARC_T2. */
+  };
+
+/* The key of a page evicted recently. */
+struct arc_ghost
+  {
+    struct list_elem elem;      /* Element in B1, B2, or free list. */
+    struct hash_elem hash_elem; /* Element in arc_ghosts. */
+    uintptr_t key;              /* Page's key. */
+    enum arc_list list;         /* ARC_NONE, ARC_B1, or ARC_B2. */
+  };
+
+static struct arc_frame *arc_frames;
+static struct arc_ghost *arc_ghost_pool;
+static struct hash arc_ghosts;  /* Ghosts on B1 or B2, by key. */
+
+/* Least recently used at the front, most recently at the back. */
+static struct list arc_t1, arc_t2, arc_b1, arc_b2;
+
+/* Frames taken off the front of T1 and T2, in order, because the
+   caller passed over them in its current pass.  They still count
+   as on T1 or T2, and go back to the front when it starts a new
+   pass.  Like lru2_parked. */
+static struct list arc_t1_parked, arc_t2_parked;
+static struct list arc_ghost_free;
+static size_t t1_cnt, t2_cnt, b1_cnt, b2_cnt;
+
+static size_t arc_c;            /* Number of frames. */
+static size_t arc_p;            /* Target size of T1. */
+
+static long long b1_hit_cnt;    /* Misses found on B1. */
+static long long b2_hit_cnt;    /* Misses found on B2. */
+
+static hash_hash_func ghost_hash;
+static hash_less_func ghost_less;
+
+static bool
+arc_init (size_t frame_cnt)
+{
+  size_t i;
+
+  arc_c = frame_cnt;
+  arc_frames = calloc_tagged (frame_cnt, sizeof *arc_frames, MEM_VM);
+  arc_ghost_pool = calloc_tagged (frame_cnt, sizeof *arc_ghost_pool, MEM_VM);
+  if (arc_frames == NULL || arc_ghost_pool == NULL
+      || !hash_init (&arc_ghosts, ghost_hash, ghost_less, NULL))
+    return false;
+
+  list_init (&arc_t1);
+  list_init (&arc_t2);
+  list_init (&arc_t1_parked);
+  list_init (&arc_t2_parked);
+  list_init (&arc_b1);
+  list_init (&arc_b2);
+  list_init (&arc_ghost_free);
+  for (i = 0; i < frame_cnt; i++)
+    list_push_back (&arc_ghost_free, &arc_ghost_pool[i].elem);
+  return true;
+}
+
+/* Puts frame F at the most recently used end of LIST. */
+static void
+arc_push (struct arc_frame *f, enum arc_list list)
+{
+  ASSERT (f->list == ARC_NONE);
+  f->list = list;
+  if (list == ARC_T1)
+    {
+      list_push_back (&arc_t1, &f->elem);
+      t1_cnt++;
+    }
+  else
+    {
+      list_push_back (&arc_t2, &f->elem);
+      t2_cnt++;
+    }
+}
+
+/* Takes frame F off whichever list it is on. */
+static void
+arc_remove (struct arc_frame *f)
+{
+  if (f->list == ARC_NONE)
+    return;
+  list_remove (&f->elem);
+  if (f->list == ARC_T1)
+    t1_cnt--;
+  else
+    t2_cnt--;
+  f->list = ARC_NONE;
+}
+
+/* Takes ghost G off its list and returns it to the free list. */
+static void
+ghost_drop (struct arc_ghost *g)
+{
+  list_remove (&g->elem);
+  hash_delete (&arc_ghosts, &g->hash_elem);
+  if (g->list == ARC_B1)
+    b1_cnt--;
+  else
+    b2_cnt--;
+  g->list = ARC_NONE;
+  list_push_back (&arc_ghost_free, &g->elem);
+}
+
+/* Returns the ghost with KEY, or a null pointer if there is
+   none. */
+static struct arc_ghost *
+ghost_lookup (uintptr_t key)
+{
+  struct arc_ghost g;
+  struct hash_elem *e;
+
+  g.key = key;
+  e = hash_find (&arc_ghosts, &g.hash_elem);
+  return e != NULL ? hash_entry (e, struct arc_ghost, hash_elem) : NULL;
+}
+
+static void
+arc_fill (size_t idx, uintptr_t key)
+{
+  struct arc_ghost *g = ghost_lookup (key);
+
+  if (g == NULL)
+    arc_push (&arc_frames[idx], ARC_T1);
+  else
+    {
+      /* The page was evicted too soon.  Give more room to the
+         list it was evicted from, by more if that list's ghosts
+         are the fewer. */
+      if (g->list == ARC_B1)
+        {
+          size_t delta = b1_cnt >= b2_cnt ? 1 : b2_cnt / b1_cnt;
+          arc_p = arc_p + delta < arc_c ? arc_p + delta : arc_c;
+          b1_hit_cnt++;
+        }
+      else
+        {
+          size_t delta = b2_cnt >= b1_cnt ? 1 : b1_cnt / b2_cnt;
+          arc_p = arc_p > delta ? arc_p - delta : 0;
+          b2_hit_cnt++;
+        }
+      ghost_drop (g);
+      arc_push (&arc_frames[idx], ARC_T2);
+    }
+}
+
+static void
+arc_reference (size_t idx)
+{
+  struct arc_frame *f = &arc_frames[idx];
+  if (f->list != ARC_NONE)
+    {
+      arc_remove (f);
+      arc_push (f, ARC_T2);
+    }
+}
+
+/* Returns the least recently used frame on LIST that PASSED
+   does not skip, or EVICT_NONE.  Frames that it skips move to
+   PARKED. */
+static size_t
+arc_lru (struct list *list, struct list *parked, bool (*passed) (size_t))
+{
+  while (!list_empty (list))
+    {
+      struct list_elem *e = list_front (list);
+      size_t idx = list_entry (e, struct arc_frame, elem) - arc_frames;
+      if (!passed (idx))
+        return idx;
+      list_remove (e);
+      list_push_back (parked, e);
+    }
+  return EVICT_NONE;
+}
+
+/* Puts the frames on PARKED back at the front of LIST, in the
+   order they were taken off. */
+static void
+arc_unpark (struct list *list, struct list *parked)
+{
+  while (!list_empty (parked))
+    list_push_front (list, list_pop_back (parked));
+}
+
+static size_t
+arc_candidate (bool (*passed) (size_t))
+{
+  bool t1_first = t1_cnt > arc_p;
+  struct list *parked = (!list_empty (&arc_t1_parked) ? &arc_t1_parked
+                         : &arc_t2_parked);
+  size_t idx;
+
+  /* PASSED stops skipping every parked frame at once. */
+  if (!list_empty (parked)
+      && !passed (list_entry (list_front (parked), struct arc_frame, elem)
+                  - arc_frames))
+    {
+      arc_unpark (&arc_t1, &arc_t1_parked);
+      arc_unpark (&arc_t2, &arc_t2_parked);
+    }
+
+  if (t1_first)
+    {
+      idx = arc_lru (&arc_t1, &arc_t1_parked, passed);
+      if (idx == EVICT_NONE)
+        idx = arc_lru (&arc_t2, &arc_t2_parked, passed);
+    }
+  else
+    {
+      idx = arc_lru (&arc_t2, &arc_t2_parked, passed);
+      if (idx == EVICT_NONE)
+        idx = arc_lru (&arc_t1, &arc_t1_parked, passed);
+    }
+  return idx;
+}
+
+static void
+arc_evicted (size_t idx, uintptr_t key)
+{
+  struct arc_frame *f = &arc_frames[idx];
+  enum arc_list list = f->list == ARC_T1 ? ARC_B1 : ARC_B2;
+  struct arc_ghost *g;
+
+  if (f->list == ARC_NONE)
+    return;
+  arc_remove (f);
+
+  /* A stale ghost with the same key, from a page that was
+     discarded and whose key has been reused, goes first. */
+  g = ghost_lookup (key);
+  if (g != NULL)
+    ghost_drop (g);
+
+  /* Make room by forgetting the oldest ghost, from B1 if T1
+     and B1 together fill the cache, otherwise from B2. */
+  if (list_empty (&arc_ghost_free))
+    {
+      struct list *victim = ((t1_cnt + b1_cnt >= arc_c && b1_cnt > 0)
+                             || b2_cnt == 0 ? &arc_b1 : &arc_b2);
+      ghost_drop (list_entry (list_front (victim), struct arc_ghost, elem));
+    }
+
+  g = list_entry (list_pop_front (&arc_ghost_free), struct arc_ghost, elem);
+  g->key = key;
+  g->list = list;
+  hash_insert (&arc_ghosts, &g->hash_elem);
+  if (list == ARC_B1)
+    {
+      list_push_back (&arc_b1, &g->elem);
+      b1_cnt++;
+    }
+  else
+    {
+      list_push_back (&arc_b2, &g->elem);
+      b2_cnt++;
+    }
+}
+
+static void
+arc_freed (size_t idx)
+{
+  arc_remove (&arc_frames[idx]);
+}
+
+static void
+arc_print_stats (void)
+{
+  printf ("ARC: T1 target %zu of %zu frames, %lld B1 hits, %lld B2 hits\n",
+          arc_p, arc_c, b1_hit_cnt, b2_hit_cnt);
+}
+
+/* Returns a hash value for the ghost that E refers to. */
+static unsigned
+ghost_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct arc_ghost *g = hash_entry (e, struct arc_ghost, hash_elem);
+  return hash_bytes (&g->key, sizeof g->key);
+}
+
+/* Returns true if ghost A precedes ghost B. */
+static bool
+ghost_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct arc_ghost *a = hash_entry (a_, struct arc_ghost, hash_elem);
+  const struct arc_ghost *b = hash_entry (b_, struct arc_ghost, hash_elem);
+  return a->key < b->key;
+}
+
+/* The policies, default first. */
+static const struct evict_policy policies[] =
+  {
+    {"clock", clock_init, clock_fill, clock_reference, clock_candidate,
+     clock_evicted, clock_freed, NULL},
+    {"lru2", lru2_init, lru2_fill, lru2_reference, lru2_candidate,
+     lru2_evicted, lru2_freed, NULL},
+    {"arc", arc_init, arc_fill, arc_reference, arc_candidate,
+     arc_evicted, arc_freed, arc_print_stats},
+  };
+
+/* Returns the policy named NAME, or the default policy if NAME
+   is null.  Returns a null pointer if there is no policy named
+   NAME. */
+const struct evict_policy *
+evict_find (const char *name)
+{
+  size_t i;
+
+  if (name == NULL)
+    return &policies[0];
+  for (i = 0; i < sizeof policies / sizeof *policies; i++)
+    if (!strcmp (policies[i].name, name))
+      return &policies[i];
+  return NULL;
+}
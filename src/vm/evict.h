@@ -0,0 +1,59 @@
+#ifndef VM_EVICT_H
+#define VM_EVICT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* A page replacement policy.
+
+   The frame table calls a policy's functions to tell it what
+   happens to each frame, identified by its index in the table,
+   and asks it which frame to evict next.  The policy keeps
+   whatever metadata it needs for that on its own.  The frame
+   table serializes all calls to a policy's functions.
+
+   A page is identified by a KEY that stays the same while the
+   page is out of memory, so that a policy can recognize a page
+   it evicted when it comes back. */
+struct evict_policy
+  {
+    const char *name;           /* Name used to select the policy. */
+
+    /* Sets up the policy for a table of FRAME_CNT frames, all of
+       them free.  Returns false if memory is not available. */
+    bool (*init) (size_t frame_cnt);
+
+    /* Frame IDX has been filled with the page identified by
+       KEY. */
+    void (*fill) (size_t idx, uintptr_t key);
+
+    /* Frame IDX has been found in use since the last time. */
+    void (*reference) (size_t idx);
+
+    /* Returns the index of the frame that should be evicted
+       next, skipping frames for which PASSED returns true, or
+       EVICT_NONE if there is no such frame.  The frame table
+       calls this up to a few times per frame to evict one, so it
+       should not scan every frame each time. */
+    size_t (*candidate) (bool (*passed) (size_t idx));
+
+    /* The page identified by KEY has been evicted from frame
+       IDX, which is now free. */
+    void (*evicted) (size_t idx, uintptr_t key);
+
+    /* Frame IDX has been freed because its page was discarded. */
+    void (*freed) (size_t idx);
+
+    /* Prints statistics particular to the policy.  May be
+       null. */
+    void (*print_stats) (void);
+  };
+
+/* Returned by a policy's candidate function when no frame is
+   eligible. */
+#define EVICT_NONE SIZE_MAX
+
+const struct evict_policy *evict_find (const char *name);
+
+#endif /* vm/evict.h */
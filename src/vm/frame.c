@@ -0,0 +1,1017 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include "vm/cache.h"
+#include "vm/evict.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+#include "devices/timer.h"
+#include "threads/loader.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/thread.h"
+#include "userprog/pagedir.h"
+
+/* Frame table.
+
+   At startup, every page in the user pool is taken from the page
+   allocator and entered in FRAMES, so that all user memory is
+   handed out from here.  When no frame is free, a victim is
+   chosen by the page replacement policy selected with the
+   "-evict" option (see evict.c), clock by default.  The policy
+   proposes frames in the order it would like to evict them, and
+   the first one whose pages have not been accessed since they
+   were last sampled is evicted.  If that frame must be written
+   to swap, the next few proposals are searched for a cluster of
+   other dirty frames to write along with it, so that the frames
+   the next few faults need are already clean.  A page cache
+   frame is instead written back to its file, if any process that
+   maps it has written it.
+
+   The policy learns which frames are in use from a "sampler"
+   thread that wakes up every few timer ticks and checks the
+   accessed bits of a slice of the table, so that each frame is
+   sampled about once a second.  The accessed bits can't be
+   checked in the timer interrupt itself, because that needs the
+   frames' locks.
+
+   So that a page fault does not normally have to wait for a
+   victim to be written out, a "pageout" thread wakes up when
+   fewer than LOW_WATER frames are free and evicts frames, writing
+   dirty ones to swap or to their files in clusters, until
+   HIGH_WATER frames are free.  A fault that finds no free frame
+   at all still evicts one itself.
+
+   Each frame has a lock that is held while its contents are
+   being loaded, evicted, or accessed by the kernel on behalf of
+   a system call, so that it cannot be chosen for eviction then.
+   SCAN_LOCK serializes choosing victims, but is not held while
+   they are written out, so that other threads can still find
+   free frames meanwhile.
+
+   Each process's resident set size, the number of its pages in
+   frames, is kept up to date as pages are attached and detached.
+   The sampler also keeps a history of each page's accessed bit,
+   one bit per sweep over the table, and counts the pages that
+   were accessed in the last WS_WINDOW sweeps toward their
+   process's working set.  A process may have an RSS limit, set
+   with "-rsslimit" or the rsslimit system call.  It is not a hard
+   limit: while any process is over its limit, eviction first
+   looks only at frames mapped by such processes, so that a
+   process that outgrows its limit pages against itself before
+   it takes frames from everyone else.
+
+   A process may ask for a large anonymous region to be mapped
+   with 4 MB pages (see page_make_large()).  Each large page takes
+   a run of free frames that are physically contiguous and start
+   on a 4 MB boundary.  While they make up a large page, those
+   frames are marked LARGE and are never evicted, sampled, or
+   merged, since each of those works one page at a time.
+
+   The frames are zeroed once at startup, so the first time each
+   one is handed out, a page that starts out as zeros, such as a
+   new stack page, need not clear it. */
+
+static struct frame *frames;    /* Frame table. */
+static size_t frame_cnt;        /* Number of frames. */
+
+static struct lock scan_lock;   /* Serializes eviction. */
+static unsigned pass = 1;       /* Current eviction pass. */
+
+/* Page replacement policy. */
+static const struct evict_policy *policy;
+static struct lock policy_lock; /* Serializes calls into POLICY. */
+
+/* Timer ticks between samples. */
+#define SAMPLE_TICKS (TIMER_FREQ / 10)
+
+/* Number of sweeps over the frame table, of about a second
+   each, during which a page must have been accessed to count
+   toward its process's working set.  At most 8. */
+#define WS_WINDOW 4
+
+size_t frame_rss_limit;
+bool frame_report_rss;
+
+/* Number of processes over their RSS limits.  Changed only with
+   interrupts off. */
+static size_t over_limit_cnt;
+
+/* Free frames. */
+static struct lock free_lock;   /* Protects FREE_CNT. */
+static struct condition free_low; /* Signaled when FREE_CNT drops
+                                     below LOW_WATER. */
+static size_t free_cnt;         /* Number of free frames. */
+static size_t low_water;        /* Wake pageout below this many. */
+static size_t high_water;       /* Pageout stops at this many. */
+
+/* Statistics. */
+static long long hit_cnt;       /* Frames found in use. */
+static long long miss_cnt;      /* Frames filled. */
+static long long evict_cnt;     /* Frames evicted. */
+static long long pageout_cnt;   /* Frames evicted by pageout. */
+static long long over_limit_evict_cnt; /* Frames evicted from processes
+                                          over their RSS limits. */
+
+static thread_func sampler, pageout;
+static struct frame *reclaim (void);
+
+/* Selects the page replacement policy named NAME.  Returns
+   false if there is no such policy.  Must be called before
+   frame_init(). */
+bool
+frame_set_policy (const char *name) 
+{
+  policy = evict_find (name);
+  return policy != NULL;
+}
+
+/* Initializes the frame table with every page of the user
+   pool. */
+void
+frame_init (void) 
+{
+  void *kpage;
+
+  lock_init (&scan_lock);
+  lock_init (&policy_lock);
+  lock_init (&free_lock);
+  cond_init (&free_low);
+  if (policy == NULL)
+    policy = evict_find (NULL);
+
+  frames = malloc_tagged (sizeof *frames * init_ram_pages, MEM_VM);
+  if (frames == NULL)
+    PANIC ("out of memory allocating page frames");
+
+  while ((kpage = palloc_get_page (PAL_USER | PAL_ZERO)) != NULL) 
+    {
+      struct frame *f = &frames[frame_cnt++];
+      lock_init (&f->lock);
+      f->kpage = kpage;
+      list_init (&f->pages);
+      f->ref_cnt = 0;
+      f->zeroed = true;
+      f->fresh = false;
+      f->pass = 0;
+      f->large = false;
+      f->inode = NULL;
+      f->merge_sum = 0;
+      f->merge_listed = false;
+    }
+
+  free_cnt = frame_cnt;
+  low_water = frame_cnt / 32 > SWAP_CLUSTER ? frame_cnt / 32 : SWAP_CLUSTER;
+  if (low_water > frame_cnt / 8)
+    low_water = frame_cnt / 8;
+  high_water = low_water * 2;
+
+  if (!policy->init (frame_cnt))
+    PANIC ("out of memory initializing %s eviction policy", policy->name);
+}
+
+/* Starts the threads that sample the frames' accessed bits for
+   the page replacement policy and keep frames free. */
+void
+frame_start (void) 
+{
+  thread_create ("sampler", PRI_DEFAULT, sampler, NULL);
+  thread_create ("pageout", PRI_DEFAULT, pageout, NULL);
+}
+
+/* Prints frame table statistics. */
+void
+frame_print_stats (void) 
+{
+  long long total = hit_cnt + miss_cnt;
+
+  printf ("Frames: %s policy, %lld hits, %lld misses (%lld%% hit rate), "
+          "%lld evicted (%lld by pageout, %lld over RSS limits)\n",
+          policy->name, hit_cnt, miss_cnt,
+          total > 0 ? hit_cnt * 100 / total : 0, evict_cnt, pageout_cnt,
+          over_limit_evict_cnt);
+  if (policy->print_stats != NULL)
+    policy->print_stats ();
+}
+
+/* Returns true if thread T has more pages resident than its
+   RSS limit allows. */
+static bool
+over_limit (const struct thread *t) 
+{
+  return t->rss_limit != 0 && t->rss > t->rss_limit;
+}
+
+/* Adds DELTA, which is 1 or -1, to thread T's resident set
+   size. */
+static void
+rss_add (struct thread *t, int delta) 
+{
+  enum intr_level old_level = intr_disable ();
+  bool was_over = over_limit (t);
+
+  t->rss += delta;
+  if (t->rss > t->peak_rss)
+    t->peak_rss = t->rss;
+  over_limit_cnt += over_limit (t) - was_over;
+  intr_set_level (old_level);
+}
+
+/* Sets the current process's RSS limit to PAGES, or removes it
+   if PAGES is 0.  Returns the old limit. */
+size_t
+frame_set_rss_limit (size_t pages) 
+{
+  struct thread *t = thread_current ();
+  enum intr_level old_level = intr_disable ();
+  bool was_over = over_limit (t);
+  size_t old_limit = t->rss_limit;
+
+  t->rss_limit = pages;
+  over_limit_cnt += over_limit (t) - was_over;
+  intr_set_level (old_level);
+  return old_limit;
+}
+
+/* With -rss, prints the current process's resident set and
+   working set sizes. */
+void
+frame_print_usage (void) 
+{
+  struct thread *t = thread_current ();
+
+  if (frame_report_rss && t->pagedir != NULL)
+    printf ("%s: %zu pages resident (peak %zu), working set %zu pages\n",
+            t->name, t->rss, t->peak_rss, t->wss);
+}
+
+/* Returns the number of frames in the table. */
+size_t
+frame_count (void) 
+{
+  return frame_cnt;
+}
+
+/* Returns frame IDX, counting from 0. */
+struct frame *
+frame_at (size_t idx) 
+{
+  ASSERT (idx < frame_cnt);
+  return &frames[idx];
+}
+
+/* Tries to lock frame F without waiting.  Returns true if
+   successful, false if F is locked, including by the current
+   thread. */
+bool
+frame_try_lock (struct frame *f) 
+{
+  return (!lock_held_by_current_thread (&f->lock)
+          && lock_try_acquire (&f->lock));
+}
+
+/* Returns true if frame F holds nothing. */
+static bool
+frame_is_free (const struct frame *f) 
+{
+  return f->ref_cnt == 0 && f->inode == NULL;
+}
+
+/* Returns true if the pages that map frame F, which must be
+   locked, have been accessed since the last call, and clears
+   their accessed bits. */
+static bool
+frame_accessed_recently (struct frame *f) 
+{
+  bool accessed = f->accessed;
+  struct list_elem *e;
+
+  f->accessed = false;
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e)) 
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+      if (page_accessed_recently (p)) 
+        {
+          p->referenced = true;
+          accessed = true;
+        }
+    }
+  return accessed;
+}
+
+/* Returns true if frame F, which must be locked, is mapped by a
+   process over its RSS limit. */
+static bool
+frame_over_limit (struct frame *f) 
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    if (over_limit (list_entry (e, struct page, frame_elem)->thread))
+      return true;
+  return false;
+}
+
+/* Shifts whether each page that maps frame F, which must be
+   locked, was referenced into its history, and counts the pages
+   used within the window toward their processes' working
+   sets. */
+static void
+frame_sample_history (struct frame *f) 
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e)) 
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+
+      p->history = (p->history << 1) | p->referenced;
+      p->referenced = false;
+      if (p->history & ((1u << WS_WINDOW) - 1))
+        p->thread->wss_next++;
+    }
+}
+
+/* Publishes the working set that the sampler counted for thread
+   T during the sweep just finished. */
+static void
+publish_wss (struct thread *t, void *aux UNUSED) 
+{
+  t->wss = t->wss_next;
+  t->wss_next = 0;
+}
+
+/* Returns the key that identifies the page in frame F, which
+   must be locked, to the policy.  A page cache page is
+   identified by its file and offset and a private page by its
+   struct page. */
+static uintptr_t
+frame_key (struct frame *f) 
+{
+  if (f->inode != NULL)
+    return hash_bytes (&f->inode, sizeof f->inode) ^ hash_int (f->ofs);
+  else if (!list_empty (&f->pages))
+    return (uintptr_t) list_entry (list_front (&f->pages),
+                                   struct page, frame_elem);
+  else
+    return 0;
+}
+
+/* Tells the policy that frame F, which must be locked, has been
+   found in use. */
+static void
+frame_referenced (struct frame *f) 
+{
+  lock_acquire (&policy_lock);
+  hit_cnt++;
+  policy->reference (f - frames);
+  lock_release (&policy_lock);
+}
+
+/* Samples the accessed bits of every frame about once a second,
+   a slice of the table at a time, reports the frames in use to
+   the policy, and estimates each process's working set.  Frames
+   that are locked are skipped until next time. */
+static void
+sampler (void *aux UNUSED) 
+{
+  size_t slice = DIV_ROUND_UP (frame_cnt, TIMER_FREQ / SAMPLE_TICKS);
+  size_t next = 0;
+
+  for (;;) 
+    {
+      size_t i;
+
+      timer_sleep (SAMPLE_TICKS);
+      for (i = 0; i < slice; i++) 
+        {
+          struct frame *f;
+
+          if (next == 0) 
+            {
+              enum intr_level old_level = intr_disable ();
+              thread_foreach (publish_wss, NULL);
+              intr_set_level (old_level);
+            }
+          f = &frames[next];
+          if (++next >= frame_cnt)
+            next = 0;
+
+          if (!frame_try_lock (f))
+            continue;
+          if (!frame_is_free (f) && !f->large) 
+            {
+              if (frame_accessed_recently (f))
+                frame_referenced (f);
+              frame_sample_history (f);
+            }
+          lock_release (&f->lock);
+        }
+    }
+}
+
+/* Returns true if evicting frame F, which must be locked, means
+   writing it to swap. */
+static bool
+frame_needs_swap (struct frame *f) 
+{
+  struct list_elem *e;
+
+  if (f->inode != NULL)
+    return false;
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    if (page_is_dirty (list_entry (e, struct page, frame_elem)))
+      return true;
+  return false;
+}
+
+/* Records that a free frame has been taken, and wakes the
+   pageout thread if that leaves too few. */
+static void
+free_taken (void) 
+{
+  lock_acquire (&free_lock);
+  if (--free_cnt < low_water)
+    cond_signal (&free_low, &free_lock);
+  lock_release (&free_lock);
+}
+
+/* Records that a frame has become free. */
+static void
+free_returned (void) 
+{
+  lock_acquire (&free_lock);
+  free_cnt++;
+  lock_release (&free_lock);
+}
+
+/* Returns true if fewer than WATER frames are free. */
+static bool
+free_below (size_t water) 
+{
+  bool below;
+
+  lock_acquire (&free_lock);
+  below = free_cnt < water;
+  lock_release (&free_lock);
+  return below;
+}
+
+/* Evicts frames whenever fewer than LOW_WATER are free, until
+   HIGH_WATER are.  If nothing can be evicted, waits a second
+   before trying again. */
+static void
+pageout (void *aux UNUSED) 
+{
+  for (;;) 
+    {
+      lock_acquire (&free_lock);
+      while (free_cnt >= low_water)
+        cond_wait (&free_low, &free_lock);
+      lock_release (&free_lock);
+
+      while (free_below (high_water)) 
+        {
+          struct frame *f = reclaim ();
+          if (f == NULL) 
+            {
+              timer_sleep (TIMER_FREQ);
+              break;
+            }
+          pageout_cnt++;
+          lock_release (&f->lock);
+          free_returned ();
+        }
+    }
+}
+
+/* Finds a free frame, locks it, and assigns it to PAGE.
+   Returns the frame, or a null pointer if none is free. */
+static struct frame *
+find_free_frame (struct page *page) 
+{
+  size_t i;
+
+  for (i = 0; i < frame_cnt; i++)
+    {
+      struct frame *f = &frames[i];
+      if (!frame_try_lock (f))
+        continue;
+      if (frame_is_free (f)) 
+        {
+          free_taken ();
+          f->fresh = true;
+          if (page != NULL)
+            frame_attach (f, page);
+          return f;
+        } 
+      lock_release (&f->lock);
+    }
+  return NULL;
+}
+
+/* Returns true if frame IDX has already been passed over in
+   the current eviction pass.  SCAN_LOCK must be held. */
+static bool
+passed (size_t idx) 
+{
+  return frames[idx].pass == pass;
+}
+
+/* Returns the frame that the policy proposes to evict next,
+   locked, if it holds a page that has not been accessed since it
+   was last sampled and, if OVER_ONLY is true, it is mapped by a
+   process over its RSS limit.  Otherwise returns a null pointer,
+   and the frame is not proposed again in this pass.  When the
+   policy has nothing more to propose, starts a new pass.
+   SCAN_LOCK must be held. */
+static struct frame *
+next_victim (bool over_only) 
+{
+  struct frame *f;
+  size_t idx;
+
+  ASSERT (lock_held_by_current_thread (&scan_lock));
+
+  lock_acquire (&policy_lock);
+  idx = policy->candidate (passed);
+  lock_release (&policy_lock);
+  if (idx == EVICT_NONE) 
+    {
+      pass++;
+      return NULL;
+    }
+
+  f = &frames[idx];
+  f->pass = pass;
+  if (!frame_try_lock (f))
+    return NULL;
+  if (frame_is_free (f) || f->large
+      || (over_only && !frame_over_limit (f)))
+    {
+      lock_release (&f->lock);
+      return NULL;
+    }
+  if (frame_accessed_recently (f)) 
+    {
+      frame_referenced (f);
+      lock_release (&f->lock);
+      return NULL;
+    }
+  return f;
+}
+
+/* Evicts the contents of the CNT locked frames in VICTIMS.
+   Returns one of the frames that was emptied, still locked, and
+   unlocks the rest, freeing those that were emptied.  Returns a
+   null pointer if no frame could be emptied. */
+static struct frame *
+evict (struct frame *victims[], size_t cnt) 
+{
+  struct page *swap_pages[SWAP_CLUSTER];
+  bool emptied[SWAP_CLUSTER];
+  bool over[SWAP_CLUSTER];
+  uintptr_t keys[SWAP_CLUSTER];
+  struct frame *result = NULL;
+  struct tlb_batch batch;
+  size_t swap_cnt = 0;
+  size_t i;
+
+  ASSERT (cnt <= SWAP_CLUSTER);
+
+  for (i = 0; i < cnt; i++) 
+    {
+      keys[i] = frame_key (victims[i]);
+      over[i] = frame_over_limit (victims[i]);
+    }
+
+  /* Unmap each frame's pages.  A frame that hasn't been written
+     since it was loaded can be loaded again from where it came
+     from, so it is simply dropped; a dirty page cache frame is
+     written back to its file; a dirty private frame goes to
+     swap, once, on behalf of all the pages that share it.
+     The TLB is flushed once at the end: the only stale entries
+     can be the current process's, and it doesn't run in user
+     mode in the meantime. */
+  pagedir_batch_init (&batch);
+  for (i = 0; i < cnt; i++) 
+    {
+      struct frame *f = victims[i];
+      bool dirty = false;
+      struct list_elem *e;
+
+      for (e = list_begin (&f->pages); e != list_end (&f->pages);
+           e = list_next (e))
+        if (page_unmap (list_entry (e, struct page, frame_elem), &batch))
+          dirty = true;
+
+      emptied[i] = true;
+      if (f->inode != NULL)
+        cache_evict (f, dirty);
+      else if (dirty) 
+        {
+          swap_pages[swap_cnt++] = list_entry (list_front (&f->pages),
+                                               struct page, frame_elem);
+          emptied[i] = false;
+        }
+    }
+  pagedir_flush (&batch);
+
+  /* Write the dirty private pages to swap.  Pages that shared a
+     frame share its slot.  Map again any that didn't make it. */
+  if (swap_cnt > 0)
+    swap_out (swap_pages, swap_cnt);
+  for (i = 0; i < cnt; i++)
+    if (!emptied[i]) 
+      {
+        struct frame *f = victims[i];
+        struct page *p = list_entry (list_front (&f->pages),
+                                     struct page, frame_elem);
+        struct list_elem *e;
+
+        if (p->swap_slot != SWAP_NONE) 
+          {
+            emptied[i] = true;
+            for (e = list_next (&p->frame_elem); e != list_end (&f->pages);
+                 e = list_next (e))
+              swap_share (p, list_entry (e, struct page, frame_elem));
+          }
+        else
+          for (e = list_begin (&f->pages); e != list_end (&f->pages);
+               e = list_next (e))
+            page_remap (list_entry (e, struct page, frame_elem));
+      }
+
+  for (i = 0; i < cnt; i++) 
+    {
+      struct frame *f = victims[i];
+
+      if (!emptied[i]) 
+        {
+          lock_release (&f->lock);
+          continue;
+        }
+
+      while (!list_empty (&f->pages))
+        frame_detach (f, list_entry (list_front (&f->pages),
+                                     struct page, frame_elem));
+      f->zeroed = false;
+
+      lock_acquire (&policy_lock);
+      evict_cnt++;
+      if (over[i])
+        over_limit_evict_cnt++;
+      policy->evicted (f - frames, keys[i]);
+      lock_release (&policy_lock);
+
+      if (result == NULL)
+        result = f;
+      else 
+        {
+          lock_release (&f->lock);
+          free_returned ();
+        }
+    }
+  return result;
+}
+
+/* Evicts a frame, or a cluster of frames if the first one must
+   be written to swap.  Returns one of the frames emptied, still
+   locked, or a null pointer if no frame could be emptied. */
+static struct frame *
+reclaim (void) 
+{
+  unsigned first_pass;
+  bool over_only;
+  size_t i;
+
+  lock_acquire (&scan_lock);
+
+  /* Two passes over the policy's proposals are enough to find a
+     page whose accessed bit was cleared on the first pass, unless
+     every frame is locked or holds a page that can't be
+     evicted.  If any process is over its RSS limit, an extra
+     pass first looks only at its frames. */
+  first_pass = ++pass;
+  over_only = over_limit_cnt > 0;
+  for (i = 0; i < frame_cnt * (over_only ? 3 : 2); i++) 
+    {
+      struct frame *victims[SWAP_CLUSTER];
+      struct frame *f;
+      size_t victim_cnt, j;
+
+      if (pass != first_pass)
+        over_only = false;
+      victims[0] = next_victim (over_only);
+      if (victims[0] == NULL)
+        continue;
+      victim_cnt = 1;
+
+      /* If this page is going to swap, look a little further for
+         more dirty pages to write in the same batch. */
+      if (swap_enabled () && frame_needs_swap (victims[0]))
+        for (j = 0; j < SWAP_CLUSTER * 4 && victim_cnt < SWAP_CLUSTER; j++) 
+          {
+            struct frame *g = next_victim (over_only);
+            if (g == NULL)
+              continue;
+            if (frame_needs_swap (g))
+              victims[victim_cnt++] = g;
+            else
+              lock_release (&g->lock);
+          }
+
+      /* The victims are locked, so the writes can go on without
+         holding up other threads' searches. */
+      lock_release (&scan_lock);
+      f = evict (victims, victim_cnt);
+      if (f != NULL)
+        return f;
+      lock_acquire (&scan_lock);
+    }
+
+  lock_release (&scan_lock);
+  return NULL;
+}
+
+/* Tries to allocate and lock a frame for PAGE.
+   Returns the frame if successful, a null pointer on failure. */
+static struct frame *
+try_frame_alloc_and_lock (struct page *page) 
+{
+  struct frame *f;
+
+  f = find_free_frame (page);
+  if (f != NULL)
+    return f;
+
+  /* No free frame, so the pageout thread is behind.  Evict one
+     here. */
+  f = reclaim ();
+  if (f != NULL) 
+    {
+      f->fresh = true;
+      if (page != NULL)
+        frame_attach (f, page);
+    }
+  return f;
+}
+
+/* Allocates and locks a free frame for PAGE, or for the page
+   cache if PAGE is null, without evicting
+   anything.  Returns the frame, or a null pointer if there is no
+   free frame.  This is for reading ahead, so the last LOW_WATER
+   free frames are left for page faults. */
+struct frame *
+frame_alloc_free_and_lock (struct page *page) 
+{
+  if (free_below (low_water))
+    return NULL;
+  return find_free_frame (page);
+}
+
+/* Number of frames in a large page. */
+#define LARGE_FRAMES (PTSPAN / PGSIZE)
+
+/* Allocates and locks LARGE_FRAMES free frames for a large page,
+   without evicting anything, and returns the first of them.  The
+   rest follow it in the frame table, and their pages follow its
+   page in physical memory, starting at a 4 MB boundary.  The
+   frames are marked LARGE.  Returns a null pointer if there is
+   no such run of free frames, or if taking one would leave
+   fewer than LOW_WATER frames free. */
+struct frame *
+frame_alloc_large_and_lock (void) 
+{
+  size_t i, j;
+
+  if (free_below (low_water + LARGE_FRAMES))
+    return NULL;
+
+  for (i = 0; i + LARGE_FRAMES <= frame_cnt; i++) 
+    {
+      uint8_t *kpage = frames[i].kpage;
+
+      if (vtop (kpage) % PTSPAN != 0
+          || frames[i + LARGE_FRAMES - 1].kpage
+             != kpage + (LARGE_FRAMES - 1) * PGSIZE)
+        continue;
+
+      for (j = 0; j < LARGE_FRAMES; j++) 
+        {
+          struct frame *f = &frames[i + j];
+          if (!frame_try_lock (f))
+            break;
+          if (!frame_is_free (f)) 
+            {
+              lock_release (&f->lock);
+              break;
+            }
+        }
+      if (j == LARGE_FRAMES) 
+        {
+          for (j = 0; j < LARGE_FRAMES; j++) 
+            {
+              struct frame *f = &frames[i + j];
+              free_taken ();
+              f->fresh = true;
+              f->large = true;
+            }
+          return &frames[i];
+        }
+      while (j-- > 0)
+        lock_release (&frames[i + j].lock);
+    }
+  return NULL;
+}
+
+/* Makes the LARGE_FRAMES frames of the large page that starts
+   with frame FIRST ordinary frames again, which may be evicted
+   one at a time.  The large page must already have been split
+   into ordinary pages. */
+void
+frame_release_large (struct frame *first) 
+{
+  size_t i;
+
+  for (i = 0; i < LARGE_FRAMES; i++) 
+    {
+      struct frame *f = first + i;
+      lock_acquire (&f->lock);
+      ASSERT (f->large);
+      f->large = false;
+      lock_release (&f->lock);
+    }
+}
+
+/* Tries really hard to allocate and lock a frame for PAGE, or
+   for the page cache if PAGE is null.
+   Returns the frame if successful, a null pointer on failure. */
+struct frame *
+frame_alloc_and_lock (struct page *page) 
+{
+  size_t try;
+
+  for (try = 0; try < 3; try++) 
+    {
+      struct frame *f = try_frame_alloc_and_lock (page);
+      if (f != NULL) 
+        {
+          ASSERT (lock_held_by_current_thread (&f->lock));
+          return f; 
+        }
+
+      /* Other threads may be in the middle of loading or
+         evicting pages; give them a chance to finish. */
+      timer_msleep (1000);
+    }
+
+  return NULL;
+}
+
+/* Locks P's frame into memory, if it has one.
+   Upon return, p->frame will not change until P is unlocked. */
+void
+frame_lock (struct page *p) 
+{
+  /* A frame can be asynchronously removed, or replaced by
+     another when the merge thread moves P, but only while the
+     old frame is locked, and only the owner gives P a frame when
+     it has none.  So once we hold the lock of the frame that P
+     still has, it stays put. */
+  for (;;) 
+    {
+      struct frame *f = p->frame;
+      if (f == NULL)
+        return;
+      lock_acquire (&f->lock);
+      if (f == p->frame)
+        return;
+      lock_release (&f->lock);
+    }
+}
+
+/* Releases frame F for use by another page.
+   F must be locked for use by the current process, and must not
+   be in the page cache.  Any data in F is lost. */
+void
+frame_free (struct frame *f)
+{
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  ASSERT (f->inode == NULL);
+
+  while (!list_empty (&f->pages))
+    frame_detach (f, list_entry (list_front (&f->pages),
+                                 struct page, frame_elem));
+  f->zeroed = false;
+  f->fresh = false;
+  f->large = false;
+
+  lock_acquire (&policy_lock);
+  policy->freed (f - frames);
+  lock_release (&policy_lock);
+
+  lock_release (&f->lock);
+  free_returned ();
+}
+
+/* Records that page P maps frame F, which must be locked. */
+void
+frame_attach (struct frame *f, struct page *p) 
+{
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  ASSERT (p->frame == NULL);
+
+  list_push_back (&f->pages, &p->frame_elem);
+  f->ref_cnt++;
+  p->frame = f;
+  rss_add (p->thread, 1);
+}
+
+/* Records that page P no longer maps frame F, which must be
+   locked. */
+void
+frame_detach (struct frame *f, struct page *p) 
+{
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  ASSERT (p->frame == f);
+
+  list_remove (&p->frame_elem);
+  f->ref_cnt--;
+  p->frame = NULL;
+  rss_add (p->thread, -1);
+}
+
+/* Write-protects every page that maps frame F, which must be
+   locked, so that F's contents cannot change until F is unlocked
+   or frame_write_unprotect() is called. */
+void
+frame_write_protect (struct frame *f) 
+{
+  struct list_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&f->lock));
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    page_write_protect (list_entry (e, struct page, frame_elem));
+}
+
+/* Undoes frame_write_protect() on frame F, which must be
+   locked. */
+void
+frame_write_unprotect (struct frame *f) 
+{
+  struct list_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&f->lock));
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    page_write_unprotect (list_entry (e, struct page, frame_elem));
+}
+
+/* Moves the pages that map frame FROM to frame INTO, which must
+   have the same contents, and frees FROM.  Afterward every page
+   that maps INTO shares it copy-on-write.  Both frames must be
+   locked, private, and write-protected with
+   frame_write_protect(); FROM is unlocked on return. */
+void
+frame_merge (struct frame *from, struct frame *into) 
+{
+  ASSERT (lock_held_by_current_thread (&from->lock));
+  ASSERT (lock_held_by_current_thread (&into->lock));
+  ASSERT (from->inode == NULL && into->inode == NULL);
+
+  while (!list_empty (&from->pages))
+    page_move (list_entry (list_front (&from->pages),
+                           struct page, frame_elem), into);
+  frame_free (from);
+}
+
+/* Unlocks frame F, allowing it to be evicted.
+   F must be locked for use by the current process.
+   The first time F is unlocked after it is allocated, it is
+   reported to the policy as filled. */
+void
+frame_unlock (struct frame *f) 
+{
+  ASSERT (lock_held_by_current_thread (&f->lock));
+
+  if (f->fresh) 
+    {
+      f->fresh = false;
+      lock_acquire (&policy_lock);
+      miss_cnt++;
+      policy->fill (f - frames, frame_key (f));
+      lock_release (&policy_lock);
+    }
+  lock_release (&f->lock);
+}
@@ -0,0 +1,75 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include "filesys/off_t.h"
+#include "threads/synch.h"
+
+/* A physical frame from the user pool.
+
+   A frame holds either a private page, or a page of a file in
+   the page cache, which any number of processes may map.  A
+   private page is normally mapped by one process, but after
+   fork() it is shared copy-on-write by the parent and the child
+   until one of them writes it.  In every case PAGES lists the
+   pages that map the frame and REF_CNT counts them. */
+struct frame 
+  {
+    struct lock lock;           /* Prevents simultaneous access. */
+    void *kpage;                /* Kernel virtual base address. */
+    struct list pages;          /* Pages mapped to this frame. */
+    size_t ref_cnt;             /* Number of pages in PAGES. */
+    bool zeroed;                /* Still all zeros from boot? */
+    bool fresh;                 /* Not yet reported to the policy? */
+    unsigned pass;              /* Eviction pass that last skipped it. */
+    bool large;                 /* Part of a large page, so pinned? */
+
+    /* Page cache frames only. */
+    struct inode *inode;        /* Cached file, or null. */
+    off_t ofs;                  /* Page-aligned offset in INODE. */
+    struct hash_elem cache_elem; /* Element in page cache. */
+    bool accessed;              /* Read by the kernel recently? */
+
+    /* Private frames only, for merge.c. */
+    unsigned merge_sum;         /* Hash of contents when last scanned. */
+    bool merge_listed;          /* In the table of merge candidates? */
+    struct hash_elem merge_elem; /* Element in that table. */
+  };
+
+struct page;
+
+/* -rsslimit: Default RSS limit for new processes, in pages, or 0
+   for none. */
+extern size_t frame_rss_limit;
+
+/* -rss: Report each process's memory use as it exits? */
+extern bool frame_report_rss;
+
+bool frame_set_policy (const char *name);
+void frame_init (void);
+void frame_start (void);
+void frame_print_stats (void);
+
+size_t frame_count (void);
+struct frame *frame_at (size_t idx);
+bool frame_try_lock (struct frame *);
+
+size_t frame_set_rss_limit (size_t pages);
+void frame_print_usage (void);
+
+struct frame *frame_alloc_and_lock (struct page *);
+struct frame *frame_alloc_free_and_lock (struct page *);
+struct frame *frame_alloc_large_and_lock (void);
+void frame_release_large (struct frame *);
+void frame_lock (struct page *);
+void frame_unlock (struct frame *);
+void frame_free (struct frame *);
+void frame_attach (struct frame *, struct page *);
+void frame_detach (struct frame *, struct page *);
+void frame_write_protect (struct frame *);
+void frame_write_unprotect (struct frame *);
+void frame_merge (struct frame *from, struct frame *into);
+
+#endif /* vm/frame.h */
@@ -0,0 +1,200 @@
+#include "vm/merge.h"
+#include <debug.h>
+#include <hash.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "vm/frame.h"
+#include "devices/timer.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Same-page merging.
+
+   When enabled with -merge, a low-priority "merge" thread walks
+   the frame table, at most merge_rate frames a second, looking
+   for private frames with identical contents.  It hashes each
+   frame's contents, and a frame whose hash is the same as it
+   was the last time around is taken to be stable, not likely to
+   be written again soon.  Stable frames are entered in a table
+   keyed by their hash.  When a stable frame's hash matches one
+   already in the table, and their contents really are the same,
+   its pages are moved into the other frame and it is freed.
+   The frame that remains is shared copy-on-write, just like a
+   frame after fork(), so the first write to it by any of its
+   pages gets a copy.
+
+   The table is emptied at the start of each trip around the
+   frame table, so that it never lists frames whose contents have
+   long since changed.  Only the merge thread uses the frames'
+   merge_* members, and before merging a frame it write-protects
+   it and checks its contents, under the frame's lock. */
+
+unsigned merge_rate = 0;
+
+/* Times per second that the merge thread wakes up. */
+#define WAKES_PER_SEC 10
+
+/* Stable frames, by hash of contents. */
+static struct hash candidates;
+
+/* Statistics. */
+static long long scan_cnt;      /* Frames hashed. */
+static long long merge_cnt;     /* Frames merged into others. */
+
+static thread_func merger;
+static hash_hash_func candidate_hash;
+static hash_less_func candidate_less;
+static void scan (struct frame *);
+
+/* Starts the merge thread, unless merging is disabled. */
+void
+merge_start (void) 
+{
+  if (merge_rate == 0)
+    return;
+  if (!hash_init (&candidates, candidate_hash, candidate_less, NULL))
+    PANIC ("out of memory starting page merging");
+  thread_create ("merge", PRI_MIN, merger, NULL);
+}
+
+/* Prints merging statistics. */
+void
+merge_print_stats (void) 
+{
+  printf ("Merge: %lld frames scanned, %lld merged\n", scan_cnt, merge_cnt);
+}
+
+/* Scans frames, MERGE_RATE a second. */
+static void
+merger (void *aux UNUSED) 
+{
+  size_t batch = DIV_ROUND_UP (merge_rate, WAKES_PER_SEC);
+  size_t next = 0;
+
+  for (;;) 
+    {
+      size_t i;
+
+      timer_sleep (TIMER_FREQ / WAKES_PER_SEC);
+      for (i = 0; i < batch; i++) 
+        {
+          if (next == 0) 
+            {
+              /* Start a new trip with an empty table. */
+              size_t j;
+              hash_clear (&candidates, NULL);
+              for (j = 0; j < frame_count (); j++)
+                frame_at (j)->merge_listed = false;
+            }
+
+          scan (frame_at (next));
+          if (++next >= frame_count ())
+            next = 0;
+        }
+    }
+}
+
+/* Returns true if frame F, which must be locked, holds private
+   pages that can be merged. */
+static bool
+mergeable (const struct frame *f) 
+{
+  return f->inode == NULL && f->ref_cnt > 0 && !f->fresh && !f->large;
+}
+
+/* Hashes frame F and merges it into an identical stable frame
+   if there is one, or lists it as a candidate if it is stable.
+   Skips F if it is locked. */
+static void
+scan (struct frame *f) 
+{
+  struct hash_elem *e;
+  struct frame *g;
+  unsigned sum;
+
+  if (!frame_try_lock (f))
+    return;
+  if (!mergeable (f)) 
+    {
+      frame_unlock (f);
+      return;
+    }
+
+  scan_cnt++;
+  sum = hash_bytes (f->kpage, PGSIZE);
+  if (sum != f->merge_sum) 
+    {
+      /* Changed since last time, so not stable. */
+      if (f->merge_listed) 
+        {
+          hash_delete (&candidates, &f->merge_elem);
+          f->merge_listed = false;
+        }
+      f->merge_sum = sum;
+      frame_unlock (f);
+      return;
+    }
+
+  e = hash_find (&candidates, &f->merge_elem);
+  g = e != NULL ? hash_entry (e, struct frame, merge_elem) : NULL;
+  if (g == f) 
+    {
+      frame_unlock (f);
+      return;
+    }
+  if (g == NULL) 
+    {
+      hash_insert (&candidates, &f->merge_elem);
+      f->merge_listed = true;
+      frame_unlock (f);
+      return;
+    }
+
+  /* G had the same hash when it was listed.  If it still has the
+     same contents, merge F into it; otherwise, F replaces it.
+     Both frames are write-protected before they are compared, so
+     that a user write can't slip in between the comparison and
+     the merge: it faults and waits for the frame lock instead. */
+  if (!frame_try_lock (g)) 
+    {
+      frame_unlock (f);
+      return;
+    }
+  if (mergeable (g)) 
+    {
+      frame_write_protect (f);
+      frame_write_protect (g);
+      if (!memcmp (f->kpage, g->kpage, PGSIZE)) 
+        {
+          frame_merge (f, g);
+          merge_cnt++;
+          frame_unlock (g);
+          return;
+        }
+      frame_write_unprotect (f);
+      frame_write_unprotect (g);
+    }
+  hash_replace (&candidates, &f->merge_elem);
+  g->merge_listed = false;
+  f->merge_listed = true;
+  frame_unlock (f);
+  frame_unlock (g);
+}
+
+/* Returns a hash value for the frame that E refers to. */
+static unsigned
+candidate_hash (const struct hash_elem *e, void *aux UNUSED) 
+{
+  return hash_entry (e, struct frame, merge_elem)->merge_sum;
+}
+
+/* Returns true if frame A's hash is less than frame B's. */
+static bool
+candidate_less (const struct hash_elem *a_, const struct hash_elem *b_,
+                void *aux UNUSED) 
+{
+  const struct frame *a = hash_entry (a_, struct frame, merge_elem);
+  const struct frame *b = hash_entry (b_, struct frame, merge_elem);
+  return a->merge_sum < b->merge_sum;
+}
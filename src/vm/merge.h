@@ -0,0 +1,10 @@
+#ifndef VM_MERGE_H
+#define VM_MERGE_H
+
+/* -merge: Frames scanned per second, or 0 not to merge. */
+extern unsigned merge_rate;
+
+void merge_start (void);
+void merge_print_stats (void);
+
+#endif /* vm/merge.h */
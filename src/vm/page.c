@@ -0,0 +1,1055 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "filesys/filesys.h"
+#include "threads/cpu.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/cache.h"
+#include "vm/frame.h"
+#include "vm/swap.h"
+
+/* Supplemental page table.
+
+   Each process has a hash table of struct page, keyed by user
+   virtual page, that describes every page in its address space.
+   load() in userprog/process.c registers executable segments
+   here instead of reading them in, and page_fault() calls
+   page_in() to bring a page into memory the first time it is
+   touched.  Pages that are never touched are never read.
+
+   A loaded page occupies a frame from vm/frame.c, which may
+   evict it again when memory runs short.  A private page that
+   has been written goes to swap when it is evicted, and comes
+   back from there.  A shared page, from a memory-mapped file or
+   the read-only text of an executable, maps a frame in the page
+   cache (vm/cache.c) instead, so that every process that maps
+   the same part of the same file, and read() and write() on it,
+   use the same frame.
+
+   fork() copies a page table with page_table_copy().  Private
+   pages that are in memory are not copied: parent and child map
+   the same frame read-only, and the first write to it by either
+   one faults and gets a private copy.  Pages in swap share their
+   slot.  Identical private pages found by the merge thread in
+   merge.c come to share a frame the same way.
+
+   A page that is all zeros and has never been written is not
+   given a frame when it is read.  Instead, ZERO_PAGE, a single
+   page of zeros outside the frame table, is mapped read-only in
+   its place, and the first write faults and gets a frame.
+
+   A fault on a shared page also maps the pages around it that
+   are already in the page cache, so that touching them does not
+   fault.  If the fault is where the last one left off, the
+   process is probably reading through the file, so a window of
+   pages ahead of it is read into the cache and mapped as well.
+   The window doubles with each sequential fault and halves with
+   each random one.
+
+   Demand paging costs a fault per page, which for a small
+   program can take longer than reading it all in at once.  So
+   when a program is loaded, each segment of its executable no
+   larger than page_prefault_limit bytes is read in and mapped
+   right away, as long as there are free frames, reading a batch
+   of pages at a time in file order.  Larger segments are paged
+   in on demand.
+
+   A large anonymous region may be mapped with 4 MB pages
+   instead, which take one TLB entry and no page table each (see
+   page_make_large()).  Its pages still have struct page and
+   frames of their own, but while the large page is in place
+   their frames are pinned and nothing maps or unmaps them one
+   at a time.  Before anything does, when the region is unmapped
+   or the process forks or exits, the large page is split into
+   ordinary pages, mapped by a page table that was set aside for
+   the purpose when the large page was made.
+
+   The stack starts out as a single page and grows on demand: an
+   access to an unmapped page no more than 32 bytes below the
+   user stack pointer, the most that PUSHA pushes before it
+   writes, adds a zero page there, as long as the stack stays
+   within page_stack_limit bytes. */
+
+/* Largest size of a user stack, in bytes. */
+size_t page_stack_limit = 8 * 1024 * 1024;
+
+/* Largest executable segment read in at load time, in bytes. */
+size_t page_prefault_limit = 64 * 1024;
+
+/* Pages mapped around a fault on a shared page: the aligned
+   block of this many pages that contains the faulting page. */
+#define FAULT_AROUND 8
+
+/* Largest read-ahead window, in pages. */
+#define READ_AHEAD_MAX 32
+
+/* Private pages read in at once by page_populate(). */
+#define POPULATE_BATCH 16
+
+/* Page of zeros mapped by every untouched zero-fill page. */
+static void *zero_page;
+
+/* Statistics. */
+static long long zero_map_cnt;  /* Read faults served by ZERO_PAGE. */
+static long long around_cnt;    /* Pages mapped around faults. */
+static long long eager_seg_cnt; /* Segments read in at load time. */
+static long long lazy_seg_cnt;  /* Segments left to demand paging. */
+static long long populate_cnt;  /* Pages read in at load time. */
+static long long large_cnt;     /* Large pages mapped. */
+static long long large_fail_cnt; /* Large pages requested but not mapped. */
+static long long split_cnt;     /* Large pages split. */
+
+/* A 4 MB region of a process's address space mapped by a large
+   page. */
+struct large_region 
+  {
+    struct list_elem elem;      /* Element in thread's LARGE_REGIONS. */
+    uint8_t *base;              /* 4 MB-aligned user address. */
+    struct frame *frame;        /* First of its frames. */
+    uint32_t *pt;               /* Page table to split it into. */
+  };
+
+static hash_hash_func page_hash;
+static hash_less_func page_less;
+static hash_action_func page_free;
+static struct page *add_page (void *upage, bool writable);
+static bool map_page (struct page *);
+static bool unshare_page (struct page *);
+static void fault_around (struct page *);
+static void split_large (struct thread *, struct large_region *);
+
+/* Initializes the supplemental page table module. */
+void
+page_init (void) 
+{
+  zero_page = palloc_get_page (PAL_ZERO | PAL_TAG (MEM_VM));
+  if (zero_page == NULL)
+    PANIC ("out of memory allocating zero page");
+}
+
+/* Prints paging statistics. */
+void
+page_print_stats (void) 
+{
+  printf ("Paging: %lld zero page maps, %lld pages mapped around faults\n",
+          zero_map_cnt, around_cnt);
+  printf ("Paging: %lld segments loaded eagerly (%lld pages), "
+          "%lld on demand\n", eager_seg_cnt, populate_cnt, lazy_seg_cnt);
+  printf ("Paging: %lld large pages mapped, %lld refused, %lld split\n",
+          large_cnt, large_fail_cnt, split_cnt);
+}
+
+/* Creates an empty supplemental page table for the current
+   process.  Returns true if successful, false if memory is not
+   available. */
+bool
+page_table_create (void) 
+{
+  struct thread *t = thread_current ();
+
+  ASSERT (t->pages == NULL);
+
+  t->pages = malloc_tagged (sizeof *t->pages, MEM_VM);
+  if (t->pages == NULL)
+    return false;
+  if (!hash_init (t->pages, page_hash, page_less, NULL)) 
+    {
+      free (t->pages);
+      t->pages = NULL;
+      return false;
+    }
+  list_init (&t->large_regions);
+  t->rss_limit = frame_rss_limit;
+  return true;
+}
+
+/* Destroys the current process's supplemental page table, if it
+   has one, and frees the frames of its loaded pages.  Must be
+   called before the process's page directory is destroyed, so
+   that pagedir_destroy() does not free the frames itself. */
+void
+page_table_destroy (void) 
+{
+  struct thread *t = thread_current ();
+
+  if (t->pages != NULL) 
+    {
+      hash_destroy (t->pages, page_free);
+      free (t->pages);
+      t->pages = NULL;
+    }
+}
+
+/* Adds a copy of PARENT's page P to the current process's page
+   table.  Returns true if successful, false if memory is not
+   available. */
+static bool
+copy_page (struct thread *parent, struct page *p) 
+{
+  struct thread *t = thread_current ();
+  struct page *q = add_page (p->upage, p->writable);
+  struct frame *f;
+  bool success;
+
+  if (q == NULL)
+    return false;
+  q->shared = p->shared;
+  q->file = p->file == parent->exec_file ? t->exec_file : p->file;
+  q->file_ofs = p->file_ofs;
+  q->read_bytes = p->read_bytes;
+
+  /* A shared page will be found in the page cache. */
+  if (p->shared)
+    return true;
+
+  frame_lock (p);
+  if (p->swap_slot != SWAP_NONE)
+    swap_share (p, q);
+  f = p->frame;
+  if (f == NULL)
+    return true;
+
+  frame_attach (f, q);
+  pagedir_set_writable (parent->pagedir, p->upage, false);
+  success = map_page (q);
+  if (success)
+    pagedir_set_dirty (t->pagedir, q->upage,
+                       pagedir_is_dirty (parent->pagedir, p->upage));
+  else
+    frame_detach (f, q);
+  frame_unlock (f);
+  return success;
+}
+
+/* Fills the current process's empty page table with a copy of
+   PARENT's, for fork().  PARENT must not run until this returns.
+   Private pages in memory are shared copy-on-write with PARENT.
+   Pages of PARENT's executable refer to the current process's
+   own EXEC_FILE instead, but pages of other files still refer to
+   PARENT's open files, which the caller must replace.  The
+   current process inherits PARENT's RSS limit.  PARENT's large
+   pages are split into ordinary pages.
+   Returns true if successful, false if memory is not
+   available. */
+bool
+page_table_copy (struct thread *parent) 
+{
+  struct hash_iterator i;
+
+  ASSERT (thread_current ()->pages != NULL);
+  ASSERT (parent->pages != NULL);
+
+  thread_current ()->rss_limit = parent->rss_limit;
+
+  /* Copy-on-write works a page at a time. */
+  while (!list_empty (&parent->large_regions))
+    split_large (parent, list_entry (list_front (&parent->large_regions),
+                                     struct large_region, elem));
+
+  hash_first (&i, parent->pages);
+  while (hash_next (&i))
+    if (!copy_page (parent, hash_entry (hash_cur (&i), struct page,
+                                        hash_elem)))
+      return false;
+  return true;
+}
+
+/* Adds user page UPAGE to the current process's page table,
+   initialized with READ_BYTES bytes from FILE starting at offset
+   OFS followed by zeros.  The page is writable by the process if
+   WRITABLE is true.  FILE must stay open as long as the page
+   does.
+   Returns true if successful, false if UPAGE is already in the
+   table or memory is not available. */
+bool
+page_add_file (void *upage, struct file *file, off_t ofs,
+               size_t read_bytes, bool writable) 
+{
+  struct page *p;
+
+  ASSERT (read_bytes <= PGSIZE);
+
+  p = add_page (upage, writable);
+  if (p == NULL)
+    return false;
+  p->file = read_bytes > 0 ? file : NULL;
+  p->file_ofs = ofs;
+  p->read_bytes = read_bytes;
+  return true;
+}
+
+/* Adds user page UPAGE to the current process's page table,
+   mapping the page of FILE at offset OFS, which must be
+   page-aligned, through the page cache.  Changes to the page are
+   written back to FILE, except beyond its end.  The page is
+   writable by the process if WRITABLE is true.  FILE must stay
+   open as long as the page does.
+   Returns true if successful, false if UPAGE is already in the
+   table or memory is not available. */
+bool
+page_add_shared (void *upage, struct file *file, off_t ofs, bool writable) 
+{
+  struct page *p;
+
+  ASSERT (ofs % PGSIZE == 0);
+
+  p = add_page (upage, writable);
+  if (p == NULL)
+    return false;
+  p->shared = true;
+  p->file = file;
+  p->file_ofs = ofs;
+  return true;
+}
+
+/* Adds user page UPAGE to the current process's page table,
+   initialized to all zeros.  The page is writable by the process
+   if WRITABLE is true.
+   Returns true if successful, false if UPAGE is already in the
+   table or memory is not available. */
+bool
+page_add_zero (void *upage, bool writable) 
+{
+  return add_page (upage, writable) != NULL;
+}
+
+/* Returns the page in T's page table that contains user address
+   UADDR, or a null pointer if there is none. */
+struct page *
+page_lookup (struct thread *t, const void *uaddr) 
+{
+  struct page p;
+  struct hash_elem *e;
+
+  if (t->pages == NULL || !is_user_vaddr (uaddr))
+    return NULL;
+
+  p.upage = pg_round_down (uaddr);
+  e = hash_find (t->pages, &p.hash_elem);
+  return e != NULL ? hash_entry (e, struct page, hash_elem) : NULL;
+}
+
+/* Reads in the pages that follow page P in swap, which must be
+   locked in memory, as long as they belong to the same process,
+   are not already in memory, and there are free frames to hold
+   them.  They are mapped with their accessed bits clear, so that
+   they are the first to go again if they are not used. */
+static void
+read_ahead (struct page *p) 
+{
+  size_t i;
+
+  for (i = 1; i < SWAP_READ_AHEAD; i++) 
+    {
+      /* Only the owner brings its pages into memory, and that's
+         us, so Q cannot gain a frame behind our back. */
+      struct page *q = swap_page (p->swap_slot + i, p->thread);
+      if (q == NULL || q->frame != NULL)
+        break;
+
+      q->frame = frame_alloc_free_and_lock (q);
+      if (q->frame == NULL)
+        break;
+      swap_in (q, true);
+      if (!map_page (q)) 
+        {
+          struct frame *f = q->frame;
+          q->frame = NULL;
+          frame_free (f);
+          break;
+        }
+      frame_unlock (q->frame);
+    }
+}
+
+/* Returns true if page P, which must not have a frame, is all
+   zeros. */
+static bool
+is_zero (const struct page *p) 
+{
+  return !p->shared && p->file == NULL && p->swap_slot == SWAP_NONE;
+}
+
+/* Removes P's mapping of ZERO_PAGE from its owner's page
+   directory, if it has one. */
+static void
+unmap_zero (struct page *p) 
+{
+  uint32_t *pd = p->thread->pagedir;
+
+  if (pagedir_get_page (pd, p->upage) == zero_page)
+    pagedir_clear_page (pd, p->upage);
+}
+
+/* Locks a frame for page P and pages in.
+   Returns true if successful, false on failure. */
+static bool
+do_page_in (struct page *p) 
+{
+  uint8_t *kpage;
+  off_t read;
+
+  unmap_zero (p);
+
+  if (p->shared) 
+    {
+      struct frame *f = cache_lock (file_get_inode (p->file), p->file_ofs);
+      if (f == NULL)
+        return false;
+      frame_attach (f, p);
+      return true;
+    }
+
+  p->frame = frame_alloc_and_lock (p);
+  if (p->frame == NULL)
+    return false;
+  kpage = p->frame->kpage;
+
+  if (p->swap_slot != SWAP_NONE) 
+    {
+      swap_in (p, false);
+      read_ahead (p);
+      return true;
+    }
+
+  read = 0;
+  if (p->file != NULL) 
+    {
+      lock_acquire (&filesys_lock);
+      read = file_read_at (p->file, kpage, p->read_bytes, p->file_ofs);
+      lock_release (&filesys_lock);
+    }
+  if (read != (off_t) p->read_bytes) 
+    {
+      struct frame *f = p->frame;
+      p->frame = NULL;
+      frame_free (f);
+      return false;
+    }
+  if (!p->frame->zeroed)
+    memset (kpage + p->read_bytes, 0, PGSIZE - p->read_bytes);
+  return true;
+}
+
+/* Returns the current process's page that contains UADDR.  If
+   there is none, but UADDR looks like an access to the stack
+   just below the user stack pointer, adds a zero page there to
+   grow the stack, and returns that.  Otherwise returns a null
+   pointer. */
+static struct page *
+lookup_or_grow (const void *uaddr) 
+{
+  struct thread *t = thread_current ();
+  struct page *p = page_lookup (t, uaddr);
+
+  if (p == NULL
+      && is_user_vaddr (uaddr)
+      && (uint8_t *) uaddr >= (uint8_t *) PHYS_BASE - page_stack_limit
+      && (uint8_t *) uaddr + 32 >= (uint8_t *) t->user_esp)
+    p = add_page (pg_round_down (uaddr), true);
+  return p;
+}
+
+/* Returns true if page P, whose frame must be locked, may be
+   mapped writable: it is writable, and it does not share its
+   frame copy-on-write. */
+static bool
+may_write (struct page *p) 
+{
+  return p->writable && (p->shared || p->frame->ref_cnt == 1);
+}
+
+/* Maps P's frame, which must be locked, into its owner's page
+   directory, or if it is already mapped, makes it writable if it
+   may now be written.  Returns true if successful, false if
+   memory is not available. */
+static bool
+map_page (struct page *p) 
+{
+  uint32_t *pd = p->thread->pagedir;
+
+  if (pagedir_get_page (pd, p->upage) == NULL)
+    return pagedir_set_page (pd, p->upage, p->frame->kpage, may_write (p));
+  if (may_write (p))
+    pagedir_set_writable (pd, p->upage, true);
+  return true;
+}
+
+/* Gives page P, whose frame must be locked, a copy of its frame,
+   if it shares it copy-on-write, so that it can be written.  The
+   old frame is unlocked and the new one is locked in its place.
+   Returns true if successful, false if no frame is available. */
+static bool
+unshare_page (struct page *p) 
+{
+  struct frame *old = p->frame;
+  struct frame *new;
+
+  if (p->shared || old->ref_cnt == 1)
+    return true;
+
+  new = frame_alloc_and_lock (NULL);
+  if (new == NULL)
+    return false;
+  memcpy (new->kpage, old->kpage, PGSIZE);
+
+  page_unmap (p, NULL);
+  frame_detach (old, p);
+  frame_unlock (old);
+  frame_attach (new, p);
+  return true;
+}
+
+/* Brings the page containing FAULT_ADDR into memory and maps it
+   in the current process's page directory.  If WRITE is true,
+   the fault was caused by a write, and the page is given a copy
+   of its frame if it shares one copy-on-write.  A read of an
+   untouched zero-fill page maps ZERO_PAGE instead of a frame.
+   A fault just below the user stack grows the stack.
+   Returns true if successful, false if FAULT_ADDR is not in the
+   process's page table, WRITE is true and the page is
+   read-only, or the page could not be loaded. */
+bool
+page_in (const void *fault_addr, bool write) 
+{
+  struct page *p = lookup_or_grow (fault_addr);
+  bool success;
+
+  if (p == NULL || (write && !p->writable))
+    return false;
+
+  frame_lock (p);
+  if (p->frame == NULL && !write && is_zero (p)) 
+    {
+      zero_map_cnt++;
+      return pagedir_set_page (p->thread->pagedir, p->upage, zero_page,
+                               false);
+    }
+  if (p->frame == NULL && !do_page_in (p))
+    return false;
+  ASSERT (lock_held_by_current_thread (&p->frame->lock));
+
+  success = (!write || unshare_page (p)) && map_page (p);
+  frame_unlock (p->frame);
+  if (success && p->shared)
+    fault_around (p);
+  return success;
+}
+
+/* Returns T's page at UPAGE if it is a shared page of INODE,
+   otherwise a null pointer. */
+static struct page *
+neighbor (struct thread *t, const void *upage, struct inode *inode) 
+{
+  struct page *q = page_lookup (t, upage);
+  return (q != NULL && q->shared && file_get_inode (q->file) == inode
+          ? q : NULL);
+}
+
+/* Maps the pages around shared page P, which just faulted, that
+   are in the page cache, after reading ahead the process's
+   read-ahead window. */
+static void
+fault_around (struct page *p) 
+{
+  struct thread *t = p->thread;
+  struct inode *inode = file_get_inode (p->file);
+  uint8_t *start, *end, *upage;
+  size_t i;
+
+  if (p->upage == t->fault_next)
+    t->fault_window = (t->fault_window == 0 ? 2
+                       : t->fault_window < READ_AHEAD_MAX / 2
+                       ? t->fault_window * 2 : READ_AHEAD_MAX);
+  else
+    t->fault_window /= 2;
+
+  /* Read ahead.  Stop at the end of the file's pages, or if
+     there are no free frames, since evicting pages to read ahead
+     others is a bad trade. */
+  end = (uint8_t *) p->upage + PGSIZE;
+  for (i = 0; i < t->fault_window; i++, end += PGSIZE) 
+    {
+      struct page *q = neighbor (t, end, inode);
+      if (q == NULL
+          || (q->frame == NULL && !cache_read_ahead (inode, q->file_ofs)))
+        break;
+    }
+
+  /* Map everything from the start of P's block to the end of
+     its block or the window, whichever is later.  Only we give
+     our pages frames, so a page without one keeps it that way
+     until we give it one here. */
+  start = (uint8_t *) p->upage - pg_no (p->upage) % FAULT_AROUND * PGSIZE;
+  if (end < start + FAULT_AROUND * PGSIZE)
+    end = start + FAULT_AROUND * PGSIZE;
+  for (upage = start; upage < end; upage += PGSIZE) 
+    {
+      struct page *q = neighbor (t, upage, inode);
+      struct frame *f;
+
+      if (q == NULL || q->frame != NULL)
+        continue;
+      f = cache_lock_cached (inode, q->file_ofs);
+      if (f == NULL)
+        continue;
+      frame_attach (f, q);
+      if (map_page (q))
+        around_cnt++;
+      else
+        frame_detach (f, q);
+      frame_unlock (f);
+    }
+  t->fault_next = end;
+}
+
+/* Maps shared page P, which has no frame, to its page in the
+   page cache, reading it in if necessary.  Returns false if
+   there is no free frame to read it into, true otherwise. */
+static bool
+populate_shared (struct page *p) 
+{
+  struct inode *inode = file_get_inode (p->file);
+  struct frame *f;
+
+  if (!cache_read_ahead (inode, p->file_ofs))
+    return false;
+  f = cache_lock_cached (inode, p->file_ofs);
+  if (f == NULL)
+    return true;
+  frame_attach (f, p);
+  if (map_page (p))
+    populate_cnt++;
+  else
+    frame_detach (f, p);
+  frame_unlock (f);
+  return true;
+}
+
+/* Reads in and maps the CNT private pages in BATCH, which have
+   locked frames, holding the file system lock for all of them,
+   and unlocks their frames.  Pages that can't be read or mapped
+   are left to be paged in on demand. */
+static void
+populate_private (struct page *batch[], size_t cnt) 
+{
+  bool ok[POPULATE_BATCH];
+  size_t i;
+
+  ASSERT (cnt <= POPULATE_BATCH);
+
+  lock_acquire (&filesys_lock);
+  for (i = 0; i < cnt; i++) 
+    {
+      struct page *p = batch[i];
+      ok[i] = (p->file == NULL
+               || (file_read_at (p->file, p->frame->kpage, p->read_bytes,
+                                 p->file_ofs)
+                   == (off_t) p->read_bytes));
+    }
+  lock_release (&filesys_lock);
+
+  for (i = 0; i < cnt; i++) 
+    {
+      struct page *p = batch[i];
+      uint8_t *kpage = p->frame->kpage;
+
+      if (!p->frame->zeroed)
+        memset (kpage + p->read_bytes, 0, PGSIZE - p->read_bytes);
+      if (ok[i] && map_page (p)) 
+        {
+          populate_cnt++;
+          frame_unlock (p->frame);
+        }
+      else
+        frame_free (p->frame);
+    }
+}
+
+/* Reads in and maps the SIZE bytes of pages starting at UPAGE,
+   a segment of the executable that the current process has just
+   loaded, if SIZE is at most page_prefault_limit and there are
+   enough free frames.  Otherwise, or past the point where free
+   frames run short, the pages are paged in on demand. */
+void
+page_populate (void *upage, size_t size) 
+{
+  struct thread *t = thread_current ();
+  uint8_t *end = (uint8_t *) upage + size;
+  uint8_t *next = upage;
+  bool more = true;
+
+  ASSERT (pg_ofs (upage) == 0);
+
+  if (size > page_prefault_limit) 
+    {
+      lazy_seg_cnt++;
+      return;
+    }
+  eager_seg_cnt++;
+
+  while (more && next < end) 
+    {
+      struct page *batch[POPULATE_BATCH];
+      size_t cnt = 0;
+
+      /* Give a batch of private pages frames, mapping shared
+         pages from the page cache along the way.  Read-only
+         pages of zeros are cheaper to fault in later. */
+      for (; next < end && cnt < POPULATE_BATCH; next += PGSIZE) 
+        {
+          struct page *p = page_lookup (t, next);
+          if (p == NULL || p->frame != NULL
+              || (!p->writable && is_zero (p)))
+            continue;
+          if (p->shared)
+            more = populate_shared (p);
+          else
+            more = frame_alloc_free_and_lock (p) != NULL;
+          if (!more)
+            break;
+          if (!p->shared)
+            batch[cnt++] = p;
+        }
+      populate_private (batch, cnt);
+    }
+}
+
+/* Maps the 4 MB region at UPAGE, which must be 4 MB-aligned, in
+   the current process with a single large page, if large pages
+   are enabled, there is a suitable run of free frames, and every
+   page of the region is in the page table as an untouched,
+   writable page of zeros.  Returns true if successful.
+   Otherwise, returns false, and the region's pages are left to
+   be paged in one at a time as usual. */
+bool
+page_make_large (void *upage_) 
+{
+  struct thread *t = thread_current ();
+  uint8_t *upage = upage_;
+  struct large_region *r;
+  struct frame *f;
+  uint32_t *pt;
+  size_t i;
+
+  ASSERT (large_pg_ofs (upage) == 0);
+
+  if ((cr4_read () & CR4_PSE) == 0)
+    return false;
+  for (i = 0; i < PTSPAN / PGSIZE; i++) 
+    {
+      struct page *p = page_lookup (t, upage + i * PGSIZE);
+      if (p == NULL || !p->writable || p->frame != NULL || !is_zero (p))
+        return false;
+    }
+
+  r = malloc_tagged (sizeof *r, MEM_VM);
+  pt = palloc_get_page (PAL_TAG (MEM_PAGEDIR));
+  f = r != NULL && pt != NULL ? frame_alloc_large_and_lock () : NULL;
+  if (f == NULL) 
+    {
+      free (r);
+      if (pt != NULL)
+        palloc_free_page (pt);
+      large_fail_cnt++;
+      return false;
+    }
+
+  for (i = 0; i < PTSPAN / PGSIZE; i++) 
+    {
+      struct page *p = page_lookup (t, upage + i * PGSIZE);
+      unmap_zero (p);
+      frame_attach (&f[i], p);
+      if (!f[i].zeroed)
+        memset (f[i].kpage, 0, PGSIZE);
+    }
+  pagedir_set_large_page (t->pagedir, upage, f->kpage, true);
+  for (i = 0; i < PTSPAN / PGSIZE; i++)
+    frame_unlock (&f[i]);
+
+  r->base = upage;
+  r->frame = f;
+  r->pt = pt;
+  list_push_back (&t->large_regions, &r->elem);
+  large_cnt++;
+  return true;
+}
+
+/* Splits large region R of thread T into ordinary pages, and
+   frees R.  T must be the current thread, or the parent that it
+   is forking from. */
+static void
+split_large (struct thread *t, struct large_region *r) 
+{
+  list_remove (&r->elem);
+  pagedir_split_large_page (t->pagedir, r->base, r->pt);
+  frame_release_large (r->frame);
+  free (r);
+  split_cnt++;
+}
+
+/* Marks page P, whose frame must be locked by the current
+   thread, not present in its owner's page directory, so that any
+   access from here on faults and waits on the frame lock.
+   Returns true if P was written while it was mapped.  The dirty
+   bit is left alone, and since the access that set it must have
+   come before this point, it is now final.
+   If BATCH is nonnull, the TLB entry is left for the caller to
+   flush with pagedir_flush(), which must happen before P's owner
+   next runs in user mode. */
+bool
+page_unmap (struct page *p, struct tlb_batch *batch) 
+{
+  uint32_t *pd = p->thread->pagedir;
+
+  ASSERT (p->frame != NULL);
+  ASSERT (lock_held_by_current_thread (&p->frame->lock));
+
+  pagedir_clear_page_batch (pd, p->upage, batch);
+  return pagedir_is_dirty (pd, p->upage);
+}
+
+/* Maps dirty page P, which was unmapped with page_unmap() and
+   could not be evicted after all, in its frame again. */
+void
+page_remap (struct page *p) 
+{
+  uint32_t *pd = p->thread->pagedir;
+
+  ASSERT (p->frame != NULL);
+  ASSERT (lock_held_by_current_thread (&p->frame->lock));
+
+  pagedir_set_page (pd, p->upage, p->frame->kpage, may_write (p));
+  pagedir_set_dirty (pd, p->upage, true);
+}
+
+/* Makes page P, whose frame must be locked, read-only in its
+   owner's page directory, so that a write to it faults.  For
+   when P's frame is about to be shared copy-on-write. */
+void
+page_write_protect (struct page *p) 
+{
+  ASSERT (p->frame != NULL);
+  ASSERT (lock_held_by_current_thread (&p->frame->lock));
+
+  pagedir_set_writable (p->thread->pagedir, p->upage, false);
+}
+
+/* Makes page P, whose frame must be locked, writable again in
+   its owner's page directory if it may be written, undoing
+   page_write_protect(). */
+void
+page_write_unprotect (struct page *p) 
+{
+  ASSERT (p->frame != NULL);
+  ASSERT (lock_held_by_current_thread (&p->frame->lock));
+
+  if (may_write (p))
+    pagedir_set_writable (p->thread->pagedir, p->upage, true);
+}
+
+/* Moves private page P from its frame to frame F, which must
+   have the same contents, and maps it there read-only, to be
+   shared copy-on-write.  Both frames must be locked.  If P had
+   been written, it stays dirty, so that eviction still saves
+   it. */
+void
+page_move (struct page *p, struct frame *f) 
+{
+  uint32_t *pd = p->thread->pagedir;
+  bool dirty;
+
+  ASSERT (!p->shared);
+  ASSERT (lock_held_by_current_thread (&f->lock));
+
+  dirty = page_unmap (p, NULL);
+  frame_detach (p->frame, p);
+  frame_attach (f, p);
+  if (pagedir_set_page (pd, p->upage, f->kpage, false) && dirty)
+    pagedir_set_dirty (pd, p->upage, true);
+}
+
+/* Returns true if page P, whose frame must be locked, has been
+   accessed since the last call, and clears its accessed bit. */
+bool
+page_accessed_recently (struct page *p) 
+{
+  uint32_t *pd = p->thread->pagedir;
+  bool was_accessed;
+
+  ASSERT (p->frame != NULL);
+  ASSERT (lock_held_by_current_thread (&p->frame->lock));
+
+  was_accessed = pagedir_is_accessed (pd, p->upage);
+  if (was_accessed)
+    pagedir_set_accessed (pd, p->upage, false);
+  return was_accessed;
+}
+
+/* Returns true if page P, whose frame must be locked, has been
+   written since it was loaded. */
+bool
+page_is_dirty (struct page *p) 
+{
+  ASSERT (p->frame != NULL);
+  ASSERT (lock_held_by_current_thread (&p->frame->lock));
+
+  return pagedir_is_dirty (p->thread->pagedir, p->upage);
+}
+
+/* Pages in and locks the page that contains UADDR, so that the
+   kernel can access it without it being evicted, growing the
+   stack if UADDR is just below it.  If WILL_WRITE
+   is true, the page must be writable, and it is given a copy of
+   its frame if it shares one copy-on-write.
+   Returns true if successful, false if UADDR is not a valid
+   address for the access. */
+bool
+page_lock (const void *uaddr, bool will_write) 
+{
+  struct page *p = lookup_or_grow (uaddr);
+
+  if (p == NULL || (will_write && !p->writable))
+    return false;
+
+  frame_lock (p);
+  if (p->frame == NULL && !do_page_in (p))
+    return false;
+  if ((will_write && !unshare_page (p)) || !map_page (p)) 
+    {
+      frame_unlock (p->frame);
+      return false;
+    }
+  return true;
+}
+
+/* Unlocks the page that contains UADDR, which must have been
+   locked with page_lock(). */
+void
+page_unlock (const void *uaddr) 
+{
+  struct page *p = page_lookup (thread_current (), uaddr);
+
+  ASSERT (p != NULL && p->frame != NULL);
+  frame_unlock (p->frame);
+}
+
+/* Adds a new page for UPAGE to the current process's page table
+   and returns it, or returns a null pointer if UPAGE is already
+   present or memory is not available. */
+static struct page *
+add_page (void *upage, bool writable) 
+{
+  struct thread *t = thread_current ();
+  struct page *p;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (upage));
+  ASSERT (t->pages != NULL);
+
+  p = calloc_tagged (1, sizeof *p, MEM_VM);
+  if (p == NULL)
+    return NULL;
+  p->upage = upage;
+  p->thread = t;
+  p->writable = writable;
+  p->swap_slot = SWAP_NONE;
+  if (hash_insert (t->pages, &p->hash_elem) != NULL) 
+    {
+      free (p);
+      return NULL;
+    }
+  return p;
+}
+
+/* Returns a hash value for the page that E refers to. */
+static unsigned
+page_hash (const struct hash_elem *e, void *aux UNUSED) 
+{
+  const struct page *p = hash_entry (e, struct page, hash_elem);
+  return hash_bytes (&p->upage, sizeof p->upage);
+}
+
+/* Returns true if page A precedes page B. */
+static bool
+page_less (const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED) 
+{
+  const struct page *a = hash_entry (a_, struct page, hash_elem);
+  const struct page *b = hash_entry (b_, struct page, hash_elem);
+  return a->upage < b->upage;
+}
+
+/* Removes the page that contains UADDR from the current
+   process's page table and frees it.  A shared page that was
+   written is written back to its file.  The page's TLB entry is
+   added to BATCH, if it is nonnull, for the caller to flush. */
+void
+page_remove (const void *uaddr, struct tlb_batch *batch) 
+{
+  struct thread *t = thread_current ();
+  struct page *p = page_lookup (t, uaddr);
+
+  ASSERT (p != NULL);
+  hash_delete (t->pages, &p->hash_elem);
+  page_free (&p->hash_elem, batch);
+}
+
+/* Frees the page that E refers to, and its frame if it has one
+   that isn't in the page cache or shared copy-on-write.  A
+   shared page that was written is written back to its file.
+   BATCH_, if nonnull, is a struct tlb_batch to add the page's
+   TLB entry to. */
+static void
+page_free (struct hash_elem *e, void *batch_) 
+{
+  struct page *p = hash_entry (e, struct page, hash_elem);
+  struct tlb_batch *batch = batch_;
+
+  /* A large page can only be unmapped as a whole, so split it
+     first.  Only its owner can change a page's frame while the
+     frame is part of a large page, so P->frame is stable. */
+  if (p->frame != NULL && p->frame->large) 
+    {
+      struct list_elem *le;
+
+      for (le = list_begin (&p->thread->large_regions);
+           le != list_end (&p->thread->large_regions); le = list_next (le)) 
+        {
+          struct large_region *r = list_entry (le, struct large_region, elem);
+          if ((uint8_t *) p->upage >= r->base
+              && (uint8_t *) p->upage < r->base + PTSPAN) 
+            {
+              split_large (p->thread, r);
+              break;
+            }
+        }
+    }
+
+  frame_lock (p);
+  if (p->frame != NULL) 
+    {
+      struct frame *f = p->frame;
+      bool dirty = page_unmap (p, batch);
+
+      if (p->shared || f->ref_cnt > 1) 
+        {
+          if (p->shared && dirty)
+            cache_write_back (f);
+          frame_detach (f, p);
+          frame_unlock (f);
+        }
+      else
+        frame_free (f);
+    }
+  else
+    unmap_zero (p);
+  swap_free (p);
+  free (p);
+}
@@ -0,0 +1,79 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include "threads/thread.h"
+#include "userprog/pagedir.h"
+
+/* A user virtual page in a process's supplemental page table.
+
+   Every page that a process may legally touch has one of these,
+   whether or not it is currently in memory.  The page table
+   records where the page's contents come from, so that a page
+   fault on it can be resolved by loading it. */
+struct page
+  {
+    void *upage;                /* User virtual address. */
+    struct hash_elem hash_elem; /* Element in thread's page table. */
+    struct thread *thread;      /* Owning thread. */
+    bool writable;              /* Writable by the user process? */
+    bool shared;                /* Maps FILE through the page cache? */
+
+    /* Set only while the frame's lock is held. */
+    struct frame *frame;        /* Page frame, or null if not loaded. */
+    struct list_elem frame_elem; /* Element in frame's list of pages. */
+    bool referenced;            /* Accessed since last sampled? */
+    uint8_t history;            /* One bit per sample, 1 if accessed. */
+
+    /* Initial contents of a private page: READ_BYTES bytes from
+       FILE at FILE_OFS, then zeros to the end of the page.  FILE
+       is null for a page that is all zeros.  A shared page maps
+       the page of FILE at FILE_OFS instead. */
+    struct file *file;          /* File to read from, or null. */
+    off_t file_ofs;             /* Offset in FILE. */
+    size_t read_bytes;          /* Bytes to read from FILE. */
+
+    /* Swap slot holding the page's contents, or SWAP_NONE.
+       Takes precedence over FILE.  Protected by the frame lock
+       while the page is in memory. */
+    size_t swap_slot;
+  };
+
+/* Largest size of a user stack, in bytes. */
+extern size_t page_stack_limit;
+
+/* -prefault: Largest executable segment read in at load time. */
+extern size_t page_prefault_limit;
+
+void page_init (void);
+void page_print_stats (void);
+
+bool page_table_create (void);
+void page_table_destroy (void);
+bool page_table_copy (struct thread *parent);
+
+bool page_add_file (void *upage, struct file *, off_t ofs,
+                    size_t read_bytes, bool writable);
+bool page_add_shared (void *upage, struct file *, off_t ofs,
+                      bool writable);
+bool page_add_zero (void *upage, bool writable);
+void page_remove (const void *uaddr, struct tlb_batch *);
+struct page *page_lookup (struct thread *, const void *uaddr);
+bool page_in (const void *fault_addr, bool write);
+void page_populate (void *upage, size_t size);
+bool page_make_large (void *upage);
+bool page_unmap (struct page *, struct tlb_batch *);
+void page_remap (struct page *);
+void page_write_protect (struct page *);
+void page_write_unprotect (struct page *);
+void page_move (struct page *, struct frame *);
+bool page_accessed_recently (struct page *);
+bool page_is_dirty (struct page *);
+
+bool page_lock (const void *uaddr, bool will_write);
+void page_unlock (const void *uaddr);
+
+#endif /* vm/page.h */
@@ -0,0 +1,313 @@
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <stdio.h>
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/zswap.h"
+#include "devices/block.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Swap manager.
+
+   The swap device is divided into slots of PAGE_SECTORS
+   sectors, one page each, allocated from USED_MAP.  A page keeps
+   its slot after it is read back in, so that if it is evicted
+   again without having been written, it can simply be dropped.
+   The slot is freed when the page is destroyed.  Pages that
+   shared a frame copy-on-write when it was evicted share its
+   slot, too; SLOT_REFS counts them, and a page that is written
+   again while it shares a slot gets a new one when it is next
+   swapped out.
+
+   Pages are written in batches of up to SWAP_CLUSTER.  Pages in
+   a batch that need new slots are sorted by process and address
+   and given consecutive slots where possible, and then the whole
+   batch is written in sector order.  When a page is read back
+   in, the pages in the slots that follow it are read too, if
+   they belong to the same process and are not in memory, on the
+   theory that they were evicted together because they were used
+   together.
+
+   Writes and reads go through the compressed swap cache in
+   zswap.c first, so most pages never reach the device at all. */
+
+/* The swap device. */
+static struct block *swap_device;
+
+/* Used swap slots, the page occupying each one, and the number
+   of pages that refer to each one.  When several pages share a
+   slot, SLOT_PAGES names the first of them, or none if that one
+   has given the slot up. */
+static struct bitmap *used_map;
+static struct page **slot_pages;
+static unsigned *slot_refs;
+
+/* Protects USED_MAP, SLOT_PAGES, and SLOT_REFS. */
+static struct lock swap_lock;
+
+/* Number of sectors per page. */
+#define PAGE_SECTORS (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* Statistics. */
+static long long swap_out_cnt;          /* Pages written. */
+static long long swap_batch_cnt;        /* Batches written. */
+static long long swap_in_cnt;           /* Pages read on a fault. */
+static long long read_ahead_cnt;        /* Pages read ahead. */
+
+static void sort_pages (struct page *[], size_t cnt,
+                        bool (*less) (const struct page *,
+                                      const struct page *));
+static bool slot_less (const struct page *, const struct page *);
+static bool address_less (const struct page *, const struct page *);
+static void release_slot (struct page *);
+
+/* Sets up swap. */
+void
+swap_init (void) 
+{
+  size_t slot_cnt;
+
+  lock_init (&swap_lock);
+
+  swap_device = block_get_role (BLOCK_SWAP);
+  if (swap_device == NULL) 
+    {
+      printf ("no swap device--swap disabled\n");
+      return;
+    }
+
+  slot_cnt = block_size (swap_device) / PAGE_SECTORS;
+  used_map = bitmap_create (slot_cnt);
+  slot_pages = calloc_tagged (slot_cnt, sizeof *slot_pages, MEM_VM);
+  slot_refs = calloc_tagged (slot_cnt, sizeof *slot_refs, MEM_VM);
+  if (used_map == NULL || slot_pages == NULL || slot_refs == NULL)
+    PANIC ("couldn't create swap bitmap");
+  zswap_init (swap_device, slot_cnt);
+}
+
+/* Returns true if there is a swap device to write to. */
+bool
+swap_enabled (void) 
+{
+  return used_map != NULL;
+}
+
+/* Writes the CNT pages in PAGES, whose frames must be locked by
+   the current thread, to swap.  Pages that already have a slot
+   of their own are written to it; the rest are given new
+   slots.
+   Returns the number of pages written.  Pages that could not be
+   written because swap is full have no slot on return; the
+   others are written in full. */
+size_t
+swap_out (struct page *pages[], size_t cnt) 
+{
+  struct page *new_pages[SWAP_CLUSTER];
+  size_t new_cnt, written;
+  size_t i;
+
+  ASSERT (cnt <= SWAP_CLUSTER);
+
+  if (!swap_enabled ())
+    return 0;
+
+  /* Find the pages that need slots and sort them by address.
+     A page must not overwrite a slot that other pages share. */
+  lock_acquire (&swap_lock);
+  new_cnt = 0;
+  for (i = 0; i < cnt; i++) 
+    {
+      struct page *p = pages[i];
+
+      ASSERT (lock_held_by_current_thread (&p->frame->lock));
+      if (p->swap_slot != SWAP_NONE && slot_refs[p->swap_slot] > 1)
+        release_slot (p);
+      if (p->swap_slot == SWAP_NONE)
+        new_pages[new_cnt++] = p;
+    }
+  sort_pages (new_pages, new_cnt, address_less);
+
+  /* Give them consecutive slots if we can, one by one if not. */
+  if (new_cnt > 0) 
+    {
+      size_t slot = bitmap_scan_and_flip_next (used_map, new_cnt, false);
+      for (i = 0; i < new_cnt; i++) 
+        {
+          struct page *p = new_pages[i];
+          if (slot != BITMAP_ERROR)
+            p->swap_slot = slot + i;
+          else
+            p->swap_slot = bitmap_scan_and_flip_next (used_map, 1, false);
+          if (p->swap_slot != BITMAP_ERROR) 
+            {
+              slot_pages[p->swap_slot] = p;
+              slot_refs[p->swap_slot] = 1;
+            }
+          else
+            p->swap_slot = SWAP_NONE;
+        }
+    }
+  lock_release (&swap_lock);
+
+  /* Write them in sector order. */
+  sort_pages (pages, cnt, slot_less);
+  written = 0;
+  for (i = 0; i < cnt; i++) 
+    {
+      struct page *p = pages[i];
+      size_t j;
+
+      if (p->swap_slot == SWAP_NONE)
+        continue;
+      if (!zswap_store (p->swap_slot, p->frame->kpage))
+        for (j = 0; j < PAGE_SECTORS; j++)
+          block_write (swap_device, p->swap_slot * PAGE_SECTORS + j,
+                       (uint8_t *) p->frame->kpage + j * BLOCK_SECTOR_SIZE);
+      written++;
+    }
+
+  swap_out_cnt += written;
+  if (written > 0)
+    swap_batch_cnt++;
+  return written;
+}
+
+/* Reads page P, which must have a slot and a frame locked by
+   the current thread, from swap.  READ_AHEAD says whether P is
+   being read on its own account or as a neighbor of a faulting
+   page, for statistics. */
+void
+swap_in (struct page *p, bool read_ahead) 
+{
+  size_t i;
+
+  ASSERT (p->frame != NULL);
+  ASSERT (lock_held_by_current_thread (&p->frame->lock));
+  ASSERT (p->swap_slot != SWAP_NONE);
+
+  if (!zswap_load (p->swap_slot, p->frame->kpage))
+    for (i = 0; i < PAGE_SECTORS; i++)
+      block_read (swap_device, p->swap_slot * PAGE_SECTORS + i,
+                  (uint8_t *) p->frame->kpage + i * BLOCK_SECTOR_SIZE);
+
+  if (read_ahead)
+    read_ahead_cnt++;
+  else
+    swap_in_cnt++;
+}
+
+/* Returns the page in swap slot SLOT if it belongs to thread T,
+   otherwise a null pointer. */
+struct page *
+swap_page (size_t slot, struct thread *t) 
+{
+  struct page *p = NULL;
+
+  if (swap_enabled () && slot < bitmap_size (used_map)) 
+    {
+      lock_acquire (&swap_lock);
+      p = slot_pages[slot];
+      if (p != NULL && p->thread != t)
+        p = NULL;
+      lock_release (&swap_lock);
+    }
+  return p;
+}
+
+/* Makes page Q refer to page P's swap slot instead of any slot
+   of its own.  P and Q must have the same contents. */
+void
+swap_share (struct page *p, struct page *q) 
+{
+  ASSERT (p->swap_slot != SWAP_NONE);
+
+  if (q->swap_slot == p->swap_slot)
+    return;
+
+  lock_acquire (&swap_lock);
+  if (q->swap_slot != SWAP_NONE)
+    release_slot (q);
+  q->swap_slot = p->swap_slot;
+  slot_refs[q->swap_slot]++;
+  lock_release (&swap_lock);
+}
+
+/* Gives up page P's reference to its swap slot, if it has one,
+   freeing the slot if no other page refers to it. */
+void
+swap_free (struct page *p) 
+{
+  if (p->swap_slot == SWAP_NONE)
+    return;
+
+  lock_acquire (&swap_lock);
+  release_slot (p);
+  lock_release (&swap_lock);
+}
+
+/* Gives up page P's reference to its swap slot, freeing the slot
+   if no other page refers to it.  SWAP_LOCK must be held. */
+static void
+release_slot (struct page *p) 
+{
+  size_t slot = p->swap_slot;
+
+  ASSERT (lock_held_by_current_thread (&swap_lock));
+  ASSERT (slot != SWAP_NONE && slot_refs[slot] > 0);
+
+  if (slot_pages[slot] == p)
+    slot_pages[slot] = NULL;
+  if (--slot_refs[slot] == 0) 
+    {
+      bitmap_reset (used_map, slot);
+      zswap_drop (slot);
+    }
+  p->swap_slot = SWAP_NONE;
+}
+
+/* Prints swap statistics. */
+void
+swap_print_stats (void) 
+{
+  printf ("Swap: %lld pages out in %lld batches, %lld pages in, "
+          "%lld read ahead\n",
+          swap_out_cnt, swap_batch_cnt, swap_in_cnt, read_ahead_cnt);
+}
+
+/* Sorts the CNT pages in PAGES into ascending order by LESS.
+   CNT is at most SWAP_CLUSTER, so insertion sort will do. */
+static void
+sort_pages (struct page *pages[], size_t cnt,
+            bool (*less) (const struct page *, const struct page *)) 
+{
+  size_t i, j;
+
+  for (i = 1; i < cnt; i++) 
+    {
+      struct page *p = pages[i];
+      for (j = i; j > 0 && less (p, pages[j - 1]); j--)
+        pages[j] = pages[j - 1];
+      pages[j] = p;
+    }
+}
+
+/* Returns true if page A's slot precedes page B's.  Pages
+   without slots sort last. */
+static bool
+slot_less (const struct page *a, const struct page *b) 
+{
+  return a->swap_slot < b->swap_slot;
+}
+
+/* Returns true if page A precedes page B in order by owning
+   thread, then by address. */
+static bool
+address_less (const struct page *a, const struct page *b) 
+{
+  if (a->thread != b->thread)
+    return a->thread < b->thread;
+  return a->upage < b->upage;
+}
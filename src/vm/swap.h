@@ -0,0 +1,29 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct page;
+struct thread;
+
+/* Slot number meaning "no slot". */
+#define SWAP_NONE ((size_t) -1)
+
+/* Most pages written to swap in one batch. */
+#define SWAP_CLUSTER 8
+
+/* Most pages read from swap on one fault, including the one
+   that faulted. */
+#define SWAP_READ_AHEAD 4
+
+void swap_init (void);
+bool swap_enabled (void);
+size_t swap_out (struct page *[], size_t cnt);
+void swap_in (struct page *, bool read_ahead);
+struct page *swap_page (size_t slot, struct thread *);
+void swap_share (struct page *, struct page *);
+void swap_free (struct page *);
+void swap_print_stats (void);
+
+#endif /* vm/swap.h */
@@ -0,0 +1,244 @@
+#include "vm/zswap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <list.h>
+#include <lz.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Compressed swap cache.
+
+   Swapping through the emulated IDE disk is slow, so pages
+   written to swap are compressed and kept in an arena of kernel
+   memory instead, as long as there is room.  Each page still has
+   its slot on the swap device, and the cache is keyed by slot,
+   so the swap manager allocates, shares, and frees slots as
+   usual.  When the arena fills up, the pages that have gone the
+   longest without being stored or read are decompressed and
+   written to their slots on the device.  Pages that compress
+   poorly go straight to the device.
+
+   The arena is carved into CHUNK_SIZE-byte chunks, and each
+   compressed page occupies a run of consecutive chunks. */
+
+/* Size of an arena chunk. */
+#define CHUNK_SIZE 64
+
+/* Pages that don't compress to this size or less aren't
+   worth keeping in the arena. */
+#define MAX_COMPRESSED (PGSIZE * 3 / 4)
+
+/* Number of sectors per page. */
+#define PAGE_SECTORS (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* Marks a slot that is not in the cache. */
+#define NO_CHUNK ((size_t) -1)
+
+/* A swap slot's place in the cache. */
+struct zslot
+  {
+    size_t chunk;               /* First chunk, or NO_CHUNK. */
+    size_t size;                /* Compressed size in bytes. */
+    struct list_elem lru_elem;  /* Element in LRU, if cached. */
+  };
+
+size_t zswap_size = 256 * 1024;
+
+static struct block *swap_device;
+static struct zslot *slots;     /* One per swap slot. */
+static uint8_t *arena;          /* Compressed pages. */
+static struct bitmap *used_chunks; /* Chunks in use in ARENA. */
+
+/* Cached slots, least recently stored or read first. */
+static struct list lru;
+
+/* Protects everything above, and the buffers below. */
+static struct lock zswap_lock;
+
+/* Buffers for compression and for pages being written out. */
+static uint8_t compress_buf[MAX_COMPRESSED];
+static uint8_t compress_work[LZ_WORK_SIZE];
+static uint8_t spill_buf[PGSIZE];
+
+/* Statistics. */
+static long long store_cnt;     /* Pages compressed into the arena. */
+static long long store_bytes;   /* Their total compressed size. */
+static long long reject_cnt;    /* Pages that compressed poorly. */
+static long long spill_cnt;     /* Pages written to the device. */
+static long long hit_cnt;       /* Swap-ins from the arena. */
+static long long miss_cnt;      /* Swap-ins from the device. */
+
+static void drop (struct zslot *);
+
+/* Sets up a compressed cache for the SLOT_CNT page-size slots on
+   SWAP_DEVICE, unless its size is 0. */
+void
+zswap_init (struct block *swap_device_, size_t slot_cnt)
+{
+  size_t page_cnt = zswap_size / PGSIZE;
+  size_t i;
+
+  lock_init (&zswap_lock);
+  list_init (&lru);
+  if (page_cnt == 0)
+    return;
+
+  swap_device = swap_device_;
+  slots = malloc_tagged (slot_cnt * sizeof *slots, MEM_VM);
+  arena = palloc_get_multiple (PAL_TAG (MEM_VM), page_cnt);
+  used_chunks = bitmap_create (page_cnt * PGSIZE / CHUNK_SIZE);
+  if (slots == NULL || arena == NULL || used_chunks == NULL)
+    {
+      printf ("couldn't allocate compressed swap cache--disabled\n");
+      free (slots);
+      if (arena != NULL)
+        palloc_free_multiple (arena, page_cnt);
+      if (used_chunks != NULL)
+        bitmap_destroy (used_chunks);
+      arena = NULL;
+      return;
+    }
+
+  for (i = 0; i < slot_cnt; i++)
+    slots[i].chunk = NO_CHUNK;
+}
+
+/* Compresses KPAGE into the cache as the contents of swap slot
+   SLOT, replacing any contents it had there.  Returns true if
+   successful.  If the page does not compress well, or the cache
+   is disabled, returns false, and the caller must write the page
+   to the device instead. */
+bool
+zswap_store (size_t slot, const void *kpage)
+{
+  struct zslot *z;
+  size_t size, chunk;
+
+  if (arena == NULL)
+    return false;
+
+  z = &slots[slot];
+  lock_acquire (&zswap_lock);
+  drop (z);
+
+  size = lz_compress (kpage, PGSIZE, compress_buf, sizeof compress_buf,
+                      compress_work);
+  if (size == 0)
+    {
+      reject_cnt++;
+      lock_release (&zswap_lock);
+      return false;
+    }
+
+  /* Make room by writing out the coldest pages. */
+  while ((chunk = bitmap_scan_and_flip (used_chunks, 0,
+                                        DIV_ROUND_UP (size, CHUNK_SIZE),
+                                        false)) == BITMAP_ERROR)
+    {
+      struct zslot *cold;
+      size_t cold_slot, i;
+
+      ASSERT (!list_empty (&lru));
+      cold = list_entry (list_front (&lru), struct zslot, lru_elem);
+      cold_slot = cold - slots;
+
+      lz_decompress (arena + cold->chunk * CHUNK_SIZE, cold->size,
+                     spill_buf, PGSIZE);
+      for (i = 0; i < PAGE_SECTORS; i++)
+        block_write (swap_device, cold_slot * PAGE_SECTORS + i,
+                     spill_buf + i * BLOCK_SECTOR_SIZE);
+      drop (cold);
+      spill_cnt++;
+    }
+
+  memcpy (arena + chunk * CHUNK_SIZE, compress_buf, size);
+  z->chunk = chunk;
+  z->size = size;
+  list_push_back (&lru, &z->lru_elem);
+  store_cnt++;
+  store_bytes += size;
+  lock_release (&zswap_lock);
+  return true;
+}
+
+/* Decompresses the contents of swap slot SLOT into KPAGE, if
+   they are in the cache, and returns true.  Otherwise returns
+   false, and the caller must read them from the device.  The
+   slot stays in the cache either way. */
+bool
+zswap_load (size_t slot, void *kpage)
+{
+  struct zslot *z;
+  bool cached;
+
+  if (arena == NULL)
+    return false;
+
+  z = &slots[slot];
+  lock_acquire (&zswap_lock);
+  cached = z->chunk != NO_CHUNK;
+  if (cached)
+    {
+      size_t size = lz_decompress (arena + z->chunk * CHUNK_SIZE, z->size,
+                                   kpage, PGSIZE);
+      ASSERT (size == PGSIZE);
+      list_remove (&z->lru_elem);
+      list_push_back (&lru, &z->lru_elem);
+      hit_cnt++;
+    }
+  else
+    miss_cnt++;
+  lock_release (&zswap_lock);
+  return cached;
+}
+
+/* Removes swap slot SLOT, which is being freed, from the
+   cache. */
+void
+zswap_drop (size_t slot)
+{
+  if (arena == NULL)
+    return;
+
+  lock_acquire (&zswap_lock);
+  drop (&slots[slot]);
+  lock_release (&zswap_lock);
+}
+
+/* Prints compressed swap cache statistics. */
+void
+zswap_print_stats (void)
+{
+  long long swap_ins = hit_cnt + miss_cnt;
+  long long ratio = 0;          /* Compression ratio, times 100. */
+
+  if (store_bytes > 0)
+    ratio = store_cnt * PGSIZE * 100 / store_bytes;
+
+  printf ("Zswap: %lld pages stored (%lld.%02lld:1 compression), "
+          "%lld rejected, %lld spilled, %lld hits, %lld misses "
+          "(%lld%% hit rate)\n",
+          store_cnt, ratio / 100, ratio % 100, reject_cnt, spill_cnt,
+          hit_cnt, miss_cnt, swap_ins > 0 ? hit_cnt * 100 / swap_ins : 0);
+}
+
+/* Removes Z from the cache, if it is there, freeing its chunks.
+   ZSWAP_LOCK must be held. */
+static void
+drop (struct zslot *z)
+{
+  ASSERT (lock_held_by_current_thread (&zswap_lock));
+
+  if (z->chunk == NO_CHUNK)
+    return;
+  bitmap_set_multiple (used_chunks, z->chunk,
+                       DIV_ROUND_UP (z->size, CHUNK_SIZE), false);
+  list_remove (&z->lru_elem);
+  z->chunk = NO_CHUNK;
+}